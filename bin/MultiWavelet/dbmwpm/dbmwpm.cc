@@ -2,30 +2,62 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <boost/archive/text_oarchive.hpp>
 #include "PMTimeSeries.h"
+#include "PMTimeFrequencyGrid.h"
+#include "PMArchive.h"
+#include "PMStore.h"
 #include "seispp.h"
 #include "dbpp.h"
 #include "ThreeComponentSeismogram.h"
 #include "PfStyleMetadata.h"
 using namespace SEISPP;
-void save_pmts(PMTimeSeries& d,string dir, string dfile_base,int band)
+/* Opens the file that holds all bands of one seismogram and starts 
+   an archive on it.  The file is named dir/base_sta_evid.pmts.   The 
+   caller must finish and delete the archive before closing ofp. */
+PMArchiveWriter *open_pmts(Metadata& d,string dir, string dfile_base,
+        PMArchiveFormat format, bool compress, ofstream& ofp)
 {
-    const string base_error("Error in save_pmts procedure:  ");
+    const string base_error("Error in open_pmts procedure:  ");
     try {
         string full_fname;
         string sta=d.get_string("sta");
         long int evid=d.get_long("evid");
         stringstream ss;
         ss << dir <<"/"<<dfile_base<<"_"<<sta<<"_"<<evid<<".pmts";
+        full_fname=ss.str();
+        ofp.open(full_fname.c_str(),ios::out | ios::binary);
+        if(ofp.fail()) throw SeisppError(base_error
+                + "open failed for ofstream = "+full_fname);
+        return(new PMArchiveWriter(ofp,format,compress));
+    }catch(...){throw;};
+}
+/* Saves all bands on a common time grid.  Same naming convention as 
+   open_pmts but with a different extension. */
+void save_pmtfg(PMTimeFrequencyGrid& d,string dir, string dfile_base,
+        PMArchiveFormat format, bool compress)
+{
+    const string base_error("Error in save_pmtfg procedure:  ");
+    try {
+        string full_fname;
+        string sta=d.get_string("sta");
+        long int evid=d.get_long("evid");
+        stringstream ss;
+        ss << dir <<"/"<<dfile_base<<"_"<<sta<<"_"<<evid<<".pmtfg";
         ofstream ofp;
         full_fname=ss.str();
-        ofp.open(full_fname.c_str(),ios::out);
+        ofp.open(full_fname.c_str(),ios::out | ios::binary);
         if(ofp.fail()) throw SeisppError(base_error
                 + "open failed for ofstream = "+full_fname);
-        boost::archive::text_oarchive oa(ofp);
-        oa << d;
+        /* Scoped so the archive is flushed before the close.  finish
+           reports write errors the destructor can not. */
+        {
+            PMArchiveWriter oa(ofp,format,compress);
+            oa.write(d);
+            oa.finish();
+        }
         ofp.close();
+        if(ofp.fail()) throw SeisppError(base_error
+                + "close failed for ofstream = "+full_fname);
     }catch(...){throw;};
 }
 bool dt_ok(ThreeComponentSeismogram& d,double target_dt,double tolerance)
@@ -155,6 +187,33 @@ int main(int argc, char **argv)
            be required metadata */
         string outdir=control.get_string("output_data_directory");
         string obname=control.get_string("output_file_base_name");
+        /* Output files are boost text archives unless binary is 
+           selected.   Readers detect the format so file names do 
+           not change. */
+        PMArchiveFormat archive_format(PMTextArchive);
+        if(control.is_attribute("output_archive_format"))
+            archive_format=PMArchiveFormatFromName(
+                    control.get_string("output_archive_format"));
+        /* Optional multithreaded block compression of output files.
+           Readers detect it so file names do not change either. */
+        bool compress_output(false);
+        if(control.is_attribute("output_compression"))
+            compress_output=control.get_bool("output_compression");
+        /* Optionally append all PMTimeSeries to a PMStore (one 
+           directory for the whole run) instead of writing one file
+           per seismogram.   An existing store is appended to. */
+        auto_ptr<PMStoreWriter> store;
+        if(control.is_attribute("output_store_directory"))
+        {
+            string storedir=control.get_string("output_store_directory");
+            if(storedir!="none")
+            {
+                store.reset(new PMStoreWriter(storedir));
+                cout << "dbmwpm:  appending particle motion data to store "
+                    << storedir << " holding "<<store->number_series()
+                    << " series"<<endl;
+            }
+        }
         /* Particle motion ellipse algorithm has two fundamentall
            different approaches.   sample by sample method is assume
            if avlen is 1 or less.   */
@@ -162,6 +221,17 @@ int main(int argc, char **argv)
         int pmdt(1);
         if(avlen>1)
             pmdt=control.get_int("particle_motion_sampling_decimation_factor");
+        /* Optional algorithm choices.   Any not set in the pf file 
+           are given defaults by this constructor. */
+        PMTimeSeriesControl pmcontrol(control);
+        /* Optionally also save all bands on a common time grid.  
+           0 for the grid interval means use the finest band's dt. */
+        bool save_tfgrid(false);
+        double tfgrid_dt(0.0);
+        if(control.is_attribute("save_time_frequency_grid"))
+            save_tfgrid=control.get_bool("save_time_frequency_grid");
+        if(save_tfgrid && control.is_attribute("time_frequency_grid_dt"))
+            tfgrid_dt=control.get_double("time_frequency_grid_dt");
 
         AttributeMap am("css3.0");
         DatascopeHandle dbh(dbname,true);
@@ -175,6 +245,10 @@ int main(int argc, char **argv)
             cout <<"using subset condition="<<sstr<<endl;
         long nrows=dbh.number_tuples();
         cout << "Number of rows in input view="<<nrows<<endl;
+        /* Tally of bootstrap estimates skipped by output_stride */
+        long nbssaved(0);
+        /* Tally of estimates not computed because of edge trimming */
+        long ntrimsaved(0);
 
         for(dbh.rewind(),i=0;i<nrows;++i,++dbh)
         {
@@ -193,14 +267,48 @@ int main(int argc, char **argv)
                 time defined by phase=T0.*/
                 d=ArrivalTimeReference(*d,alignkey,cutwindow);
                 MWTBundle dtransformed(*d,mwt);
+                /* All bands of this seismogram go to one file through
+                   one archive.  Declared in this order so the archive
+                   is flushed before the file closes on any exit. */
+                ofstream ofp;
+                auto_ptr<PMArchiveWriter> pmfile;
+                if(store.get()==NULL)
+                    pmfile.reset(open_pmts(*d,outdir,obname,
+                                archive_format,compress_output,ofp));
                 for(j=0;j<nbands;++j)
                 {
                     PMTimeSeries pmts;
                     if(avlen>1)
-                        pmts=PMTimeSeries(dtransformed,j,pmdt,avlen);
+                        pmts=PMTimeSeries(dtransformed,j,pmdt,avlen,
+                                0.95,100,pmcontrol);
+                    else
+                    {
+                        pmts=PMTimeSeries(dtransformed,j,0.95,100,pmcontrol);
+                        nbssaved+=pmts.get_long("bootstrap_estimates_saved");
+                    }
+                    if(pmts.is_attribute("edge_trim_estimates_saved"))
+                        ntrimsaved+=pmts.get_long("edge_trim_estimates_saved");
+                    /* Band index so readers can tell the bands apart */
+                    pmts.put("band",j);
+                    pmts.put("nbands",nbands);
+                    if(store.get()!=NULL)
+                        store->append(pmts,j);
                     else
-                        pmts=PMTimeSeries(dtransformed,j);
-                    save_pmts(pmts,outdir,obname,j);
+                        pmfile->write(pmts);
+                }
+                /* finish throws if the output is incomplete (e.g. a 
+                   full disk) so the failure is reported */
+                if(pmfile.get()!=NULL) pmfile->finish();
+                pmfile.reset();
+                if(ofp.is_open()) ofp.close();
+                if(save_tfgrid)
+                {
+                    /* Same seed as the PMTimeSeries so a seeded run is 
+                       reproducible for both outputs */
+                    PMTimeFrequencyGrid tfgrid(dtransformed,tfgrid_dt,
+                            0.95,100,avlen,pmcontrol.bootstrap_seed);
+                    save_pmtfg(tfgrid,outdir,obname,archive_format,
+                            compress_output);
                 }
             }
             else
@@ -220,6 +328,13 @@ int main(int argc, char **argv)
                 serr.log_error();
             }
        }
+       if(avlen<=1)
+           cout << "dbmwpm:  output_stride skipped "<<nbssaved
+               << " particle motion bootstrap estimates"<<endl;
+       if(mwt.edge_trimming() || pmcontrol.trim_wavelet_edges)
+           cout << "dbmwpm:  trim_wavelet_edges skipped "<<ntrimsaved
+               << " particle motion estimates within half a wavelet of "
+               << "data edges"<<endl;
     }catch(SeisppError& serr)
     {
         serr.log_error();
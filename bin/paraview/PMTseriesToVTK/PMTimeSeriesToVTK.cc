@@ -4,26 +4,30 @@
 #include <fstream>
 #include <sstream>
 #include "PMTimeSeries.h"
+#include "PMArchive.h"
 #include "stock.h"
 #include "seispp.h"
 #include "HFArray.h"
 #include "TimeWindow.h"
 #include "PfStyleMetadata.h"
 #include "AttributeMap.h"
-#include "StreamObjectReader.h"
 using namespace std;
 using namespace SEISPP;
 void usage()
 {
     cerr << "PMTseriesToVTK infile [-s -pf pffile]"<<endl
         << "infile is a serialized text file of PMTimeSeries objects or (optionally) a list of single files"<<endl
+        << "(Input may be text or binary archives, optionally block compressed)"<<endl
         << "Use -s to switch to single file input model"<<endl
         << "(In singe file mode infile should be a list of files with one seismogram per file)"<<endl
         << "Use -pf to change parameter file to pffile instead of default PMTimeSeries.pf"
         <<endl;
     exit(-1);
 }
-vector<PMTimeSeries> read_pmdata_sfmode(string listfile)
+/* Files written by dbmwpm hold all bands of one seismogram with the
+   band number in Metadata key band.  Only band is kept if it is 0 or
+   more.  Series without a band key (older files) are always kept. */
+vector<PMTimeSeries> read_pmdata_sfmode(string listfile, int band)
 {
         vector<PMTimeSeries> result;
         ifstream lfin;
@@ -37,15 +41,26 @@ vector<PMTimeSeries> read_pmdata_sfmode(string listfile)
         char fname[1024];
         while(lfin.getline(fname,1024))
         {
-            ifstream ifs(fname);
+            ifstream ifs(fname,ios::in | ios::binary);
             if(ifs.good())
             {
-                boost::archive::text_iarchive ar(ifs);
-                PMTimeSeries pmtsin;
                 try {
-                    ar >> pmtsin;
-                    result.push_back(pmtsin);
-                }catch(std::exception& err)
+                    /* Format (text or binary) is detected from the file*/
+                    PMArchiveReader ar(ifs);
+                    while(!ar.eof())
+                    {
+                        PMTimeSeries pmtsin;
+                        ar.read(pmtsin);
+                        if((band<0) || !pmtsin.is_attribute("band")
+                                || (pmtsin.get_int("band")==band))
+                            result.push_back(pmtsin);
+                    }
+                }catch(SeisppError& serr)
+                {
+                    cerr << "Error reading archive file = "<<fname<<endl;
+                    serr.log_error();
+                }
+                catch(std::exception& err)
                 {
                     cerr << "Error reading archive file = "<<fname<<endl
                         << "Message posted by boost::archive:  "
@@ -63,14 +78,20 @@ vector<PMTimeSeries> read_pmdata_sfmode(string listfile)
         lfin.close();
         return result;
 }
+/* Reads all objects from stdin.   The format (text or binary) and 
+   block compression are detected from the stream the same way as in 
+   single file mode.  PMArchiveReader reads compressed input through 
+   a BlockDecompressIStream so output of blockzip or files dbmwpm 
+   wrote with output_compression set can be piped in directly. */
 vector<PMTimeSeries> read_pmdata_serial(string listfile)
 {
   vector<PMTimeSeries> result;
   try{
-      StreamObjectReader<PMTimeSeries> inp;
-      while(inp.good())
+      PMArchiveReader ar(cin);
+      while(!ar.eof())
       {
-          PMTimeSeries pmd=inp.read();
+          PMTimeSeries pmd;
+          ar.read(pmd);
           result.push_back(pmd);
       }
       return result;
@@ -164,13 +185,11 @@ double find_max_amplitude(PMTimeSeries& d)
 {
   int i;
   double maxamp(0.0);
-  //cout << d.ns << endl;
-  //vector<ParticleMotionEllipse> v;
-  //v = d.get_pmdata();
-  for(i=0;i<d.get_pmdata().size();++i)
+  /* Scan the major axis length column directly - no copies */
+  const PMColumns& pmc=d.columns();
+  for(i=0;i<pmc.size();++i)
   {
-    ParticleMotionEllipse e=d.ellipse(i);
-    if(e.majornrm>maxamp) maxamp=e.majornrm;
+    if(pmc.majornrm[i]>maxamp) maxamp=pmc.majornrm[i];
   }
   return maxamp;
 }
@@ -306,8 +325,11 @@ int main(int argc, char **argv)
         /* Read the data defined by the input list of files */
         vector<PMTimeSeries>::iterator dptr;
         vector<PMTimeSeries> d;
+        /* Band to use from multiband files.  Default is all. */
+        int band(-1);
+        if(md.is_attribute("band")) band=md.get_int("band");
         if(singlefilemode)
-            d=read_pmdata_sfmode(infile);
+            d=read_pmdata_sfmode(infile,band);
         else
             d=read_pmdata_serial(infile);
         if(sap_mode)
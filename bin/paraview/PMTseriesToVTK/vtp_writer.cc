@@ -52,15 +52,15 @@ void WriteEllipses(vector<PMTimeSeries>& d,
                     throw ss.str();
                     }
                 ParticleMotionEllipse pme;  // assume initializes to 0;
-                try {
-                    pme=dptr->ellipse(i);
-                }catch(SeisppError& serr)
+                const PMColumns& pmc=dptr->columns();
+                if( (i>=0) && (i<pmc.size()) )
+                    pme=pmc.get_ellipse(i);
+                else
                 {
                     cerr << "Warning:  time="<<t<<" is outside range of data for station="
                         << dptr->get_string("sta")<<endl
-                        << "Message from ParticleMotionEllipse::ellipse method"
-                        <<endl;
-                    serr.log_error();
+                        << "Sample number "<<i<<" is outside data range of "
+                        << pmc.size()<<endl;
                     cerr << "Setting ellipse to zero size"<<endl;
                 }
                 dmatrix pm=pme.points(np_per_ellipse);
@@ -8,7 +8,8 @@
 #include <boost/archive/text_iarchive.hpp>
 #include "seispp.h"
 #include "ensemble.h"
-//#include "PMTimeSeries.h"
+#include "PMTimeSeries.h"
+#include "PMArchive.h"
 using namespace std;   // most compilers do not require this
 using namespace SEISPP;  //This is essential to use SEISPP library
 void usage()
@@ -23,56 +24,49 @@ void usage()
         << "        (default dumps all with operator <<"<<endl
         << " -t - specify the type of object expected"<<endl
         << "      (Currently accept:  ThreeComponentSeismogram (default), ThreeComponentEnsemble, "<<endl
-        << "and PMTimeSeries)"
+        << "and PMTimeSeries)"<<endl
+        << " infile may be a text or binary archive and may be block compressed"
         <<endl;;
     exit(-1);
 }
 enum AllowedObjects {TCS, TCE, PMTS};
-/* Special read function for this program.  Will return metadata portion of any
-   object that is a child of Metadat */
-template <class InputObject> Metadata
-    read_object(boost::archive::text_iarchive& ia)
-{
-    InputObject d;
-    try{
-        ia>>d;
-    }catch(...)
-    {
-        throw SeisppError(string("read_object failed:  ")
-                    + "Check that input file is a boost text archive file");
-    }
-    return Metadata(d);
-}
-template <class InputObject> vector<size_t> 
-        build_index(string fname)
+/* Reads the Metadata of every object in a file in one sequential pass.
+   PMArchiveReader detects text or binary archives and block compressed
+   input (see BlockCompression.h) so any of these can be listed.   
+   Returns the Metadata of each object and sets foff_values to the 
+   offset where each starts.  For compressed files this is the offset 
+   in the uncompressed data. */
+template <class InputObject> vector<Metadata> 
+        read_all_metadata(string fname, vector<size_t>& foff_values)
 {
     /* Safety valve to avoid a runaway */
-    int nd(0);
     const int ndmax(1000000);
     ifstream ifs;
-    ifs.open(fname.c_str(),ios::in);
+    ifs.open(fname.c_str(),ios::in | ios::binary);
     if(!ifs)
-        throw SeisppError(string("InputObject procedure: ")
+        throw SeisppError(string("read_all_metadata procedure: ")
                 + "cannot open file="+fname+" for input");
-    vector<size_t> foff_values;
-    boost::archive::text_iarchive ia(ifs);
-    InputObject d;
-    do{
-      try{
-        size_t foff=ifs.tellg();
-        ia >> d;
-        /* Because this loop is exited by the (evil) 
-         * method of an exception handler we don't push the foff
-         * value until here  - the loops exits when read fails*/
+    vector<Metadata> result;
+    foff_values.clear();
+    PMArchiveReader ar(ifs);
+    while(!ar.eof() && (result.size()<ndmax))
+    {
+        InputObject d;
+        size_t foff=ar.tell();
+        try{
+            ar.read(d);
+        }catch(boost::archive::archive_exception const& e)
+        {
+            cerr << "read_all_metadata:  read failed for object number "
+                << result.size()<<" of file "<<fname<<endl
+                << "Message posted by boost::archive:  "<<e.what()<<endl;
+            break;
+        }
+        result.push_back(Metadata(d));
         foff_values.push_back(foff);
-        ++nd;
-      }catch(boost::archive::archive_exception const& e)
-      {
-          break;
-      }
-    }while(nd<ndmax);  // safer than infiite loop
+    }
     ifs.close();
-    return foff_values; 
+    return result;
 }
 /*! Simple class to drive csv outputs in this program. */
 class MetadataComponent
@@ -226,21 +220,19 @@ int main(int argc, char **argv)
         if(csv_output)
             csv_format_info=parse_csv_format_file(fname_csvo);
         vector<size_t> fofflist;
+        vector<Metadata> mdlist;
         switch (dtype)
         {
             case TCS:
-                fofflist=build_index<ThreeComponentSeismogram>(infile);
+                mdlist=read_all_metadata<ThreeComponentSeismogram>(infile,
+                        fofflist);
                 break;
             case TCE:
-                cout << "Calling build_index"<<endl;
-                fofflist=build_index<ThreeComponentEnsemble>(infile);
-                cout << "Built index of size="<<fofflist.size()<<endl;
+                mdlist=read_all_metadata<ThreeComponentEnsemble>(infile,
+                        fofflist);
                 break;
             case PMTS:
-                cerr << "PMTimeSeries not yet supported"
-                    <<"Cannot run"<<endl;
-                exit(-1);
-                //fofflist=build_index<PMTimeSeries>(infile);
+                mdlist=read_all_metadata<PMTimeSeries>(infile,fofflist);
                 break;
             default:
                 cerr << "Coding problem - dtype variable does not match enum"
@@ -248,52 +240,18 @@ int main(int argc, char **argv)
                     << "Fatal error - bug fix required. "<<endl;
                 exit(-1);
         };
-        /* The above opens and closes infile.  I found boost serialization
-         * throws an exception saying invalid signature in when you try to 
-         * manipulate the ifstream used to construt the archive object */
-        ifstream ifs;
-        ifs.open(infile.c_str(),ios::in);
-        if(!ifs)
-        {
-            cerr << "Open failed on input data file"<<infile<<endl;
-            exit(-1);
-        }
-        boost::archive::text_iarchive ia(ifs);
-        int nd=fofflist.size();
-        for(i=0;i<nd;++i)
+        for(i=0;i<mdlist.size();++i)
         {
-            size_t foff=fofflist[i];
-            ifs.seekg(foff,ifs.beg);
-            Metadata d;
-            switch(dtype)
-            {
-                case TCS:
-                    d=read_object<ThreeComponentSeismogram>(ia);
-                    break;
-                case TCE:
-                    d=read_object<ThreeComponentEnsemble>(ia);
-                    break;
-                case PMTS:
-                    //d=read_object<PMTimeSeries>(ia);
-                    break;
-                default:
-                    cerr << "Unrecognized data type:  This should not happen"
-                        << "Program has probably overwritten itself from a bug"
-                        <<endl
-                        << "Cannot continue.  Exiting."<<endl;
-                    exit(-1);
-            };
             if(csv_output)
             {
-                WriteToCSVFile(d,cout,csv_format_info);
+                WriteToCSVFile(mdlist[i],cout,csv_format_info);
             }
             else
             {
                 cout << "Metadata for file index position="<<i
-                    << " at foff="<<foff<<endl;
-                cout << d;
+                    << " at foff="<<fofflist[i]<<endl;
+                cout << mdlist[i];
             }
-
         }
     }catch(SeisppError& serr)
     {
@@ -9,6 +9,7 @@
 #include "seispp.h"
 #include "Metadata.h"
 #include "dbpp.h"
+#include "BlockCompression.h"
 #include "PMVisualizerGUI.h"
 using namespace std;
 using namespace SEISPP;
@@ -26,15 +27,17 @@ string antelope_contrib_root_pf()
     return result;
 }
 /*This is a read routine from boost text archive file infile.   In
-this mode we always read the entire file.  */
+this mode we always read the entire file.  The file may be block 
+compressed (BlockCompression.h).  */
 ThreeComponentEnsemble load_data_from_file(string infile)
 {
     const string base_error("PMVisualizer load_data_from_file procedure: ");
-    std::ifstream ifp(infile.c_str(),ios::in);
+    std::ifstream ifp(infile.c_str(),ios::in | ios::binary);
     if(ifp.fail()) throw SeisppError(base_error
             + "cannot open file="+infile);
     ThreeComponentEnsemble d3c;
-    boost::archive::text_iarchive ia(ifp);
+    BlockDecompressIStream zin(ifp);
+    boost::archive::text_iarchive ia(zin);
     try {
         ia >> d3c;
     }catch(...){
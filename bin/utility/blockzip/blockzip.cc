@@ -0,0 +1,97 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+#include <iostream>
+#include "seispp.h"
+#include "BlockCompression.h"
+using namespace std;   // most compilers do not require this
+using namespace SEISPP;  //This is essential to use SEISPP library
+void usage()
+{
+    cerr << "blockzip [-d -l level -t nthreads] < infile > outfile"
+        <<endl
+        << "Block compress a stream (e.g. serialized objects passed between"
+        <<endl
+        << "seispp filters) using several threads"<<endl
+        << " -d - decompress.  Input that is not compressed is copied unchanged"
+        <<endl
+        << " -l - zlib compression level 1 (fastest, default) to 9 (smallest)"
+        <<endl
+        << " -t - number of threads (default is the OpenMP default)"<<endl;
+    exit(-1);
+}
+/* Copies all of in to out in large chunks.  Returns number of bytes
+   copied. */
+long copy_stream(istream& in, ostream& out)
+{
+    const int bufsize(BlockCompressionBlockSize);
+    vector<char> buf(bufsize);
+    long ntotal(0);
+    while(in)
+    {
+        in.read(&(buf[0]),bufsize);
+        streamsize n=in.gcount();
+        if(n<=0) break;
+        out.write(&(buf[0]),n);
+        if(out.fail()) throw SeisppError(string("copy_stream:  ")
+                + "write error on output stream");
+        ntotal+=n;
+    }
+    /* A corrupt or truncated compressed stream sets badbit */
+    if(in.bad()) throw SeisppError(string("copy_stream:  ")
+            + "read error on input stream");
+    return ntotal;
+}
+bool SEISPP::SEISPP_verbose(false);
+int main(int argc, char **argv)
+{
+    int i;
+    bool decompress(false);
+    int level(1);
+    int nthreads(0);
+    for(i=1;i<argc;++i)
+    {
+        string sarg(argv[i]);
+        if(sarg=="-d")
+            decompress=true;
+        else if(sarg=="-l")
+        {
+            ++i;
+            if(i>=argc)usage();
+            level=atoi(argv[i]);
+            if((level<1) || (level>9)) usage();
+        }
+        else if(sarg=="-t")
+        {
+            ++i;
+            if(i>=argc)usage();
+            nthreads=atoi(argv[i]);
+            if(nthreads<0) usage();
+        }
+        else
+            usage();
+    }
+    try{
+        if(decompress)
+        {
+            BlockDecompressIStream zin(cin,nthreads);
+            copy_stream(zin,cout);
+            cout.flush();
+        }
+        else
+        {
+            BlockCompressOStream zout(cout,level,nthreads);
+            copy_stream(cin,zout);
+            zout.finish();
+        }
+    }catch(SeisppError& serr)
+    {
+        serr.log_error();
+        exit(-1);
+    }
+    catch(std::exception& stexc)
+    {
+        cerr << stexc.what()<<endl;
+        exit(-1);
+    }
+}
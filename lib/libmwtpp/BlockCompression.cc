@@ -0,0 +1,345 @@
+#include <string.h>
+#include <sstream>
+#include <zlib.h>
+#include <omp.h>
+#include "SeisppError.h"
+#include "BlockCompression.h"
+using namespace std;
+using namespace SEISPP;
+const unsigned char BlockCompressionTag[4]={0x89,'S','P','Z'};
+const int BlockCompressionHeaderSize(8);
+/* Codec byte for zlib.   The only codec at present. */
+const int BlockCodecZlib(1);
+/* High bit of the stored length marks a block stored uncompressed */
+const uint32_t BlockStoredFlag(0x80000000u);
+static void put32(unsigned char *p, uint32_t v)
+{
+    for(int i=0;i<4;++i) p[i]=(unsigned char)(v>>(8*i));
+}
+static uint32_t get32(const unsigned char *p)
+{
+    uint32_t v(0);
+    for(int i=0;i<4;++i) v|=((uint32_t)p[i])<<(8*i);
+    return v;
+}
+static int default_threads(int n)
+{
+    if(n>0) return n;
+    n=omp_get_max_threads();
+    if(n<1) n=1;
+    return n;
+}
+bool is_block_compression_tag(int c)
+{
+    return(c==(int)BlockCompressionTag[0]);
+}
+BlockCompressBuf::BlockCompressBuf(ostream& os, int lev, int nt,
+        int bs) : out(os)
+{
+    if((bs<=0) || (bs>BlockCompressionMaxBlockSize))
+    {
+        ostringstream message;
+        message << "BlockCompressBuf constructor:  illegal block size="
+            << bs<<endl
+            << "Must be positive and no more than "
+            << BlockCompressionMaxBlockSize<<endl;
+        throw SeisppError(message.str());
+    }
+    level=lev;
+    nthreads=default_threads(nt);
+    blocksize=bs;
+    header_written=false;
+    finished=false;
+    failed=false;
+    raw.resize(((size_t)nthreads)*((size_t)blocksize));
+    stored.resize(nthreads);
+    this->setp(&(raw[0]),&(raw[0])+raw.size());
+}
+BlockCompressBuf::~BlockCompressBuf()
+{
+    /* Errors can not be reported from a destructor.  A failed write
+       leaves the output stream in a failed state. */
+    try {
+        this->finish();
+    }catch(...){};
+}
+/* Compresses and writes everything in the put area.   Returns false
+   if anything failed. */
+bool BlockCompressBuf::write_blocks()
+{
+    size_t n=this->pptr()-this->pbase();
+    if(!header_written)
+    {
+        unsigned char hdr[BlockCompressionHeaderSize];
+        memset(hdr,0,BlockCompressionHeaderSize);
+        memcpy(hdr,BlockCompressionTag,4);
+        hdr[4]=(unsigned char)('0'+BlockCompressionVersion);
+        hdr[5]=(unsigned char)BlockCodecZlib;
+        out.write((const char *)hdr,BlockCompressionHeaderSize);
+        header_written=true;
+    }
+    if(n==0) return(!out.fail());
+    int nb=(n+blocksize-1)/blocksize;
+    vector<uint32_t> rawlen(nb),storedlen(nb);
+    bool zfailed(false);
+    int b;
+#pragma omp parallel for schedule(dynamic,1) if(nb>1)
+    for(b=0;b<nb;++b)
+    {
+        size_t i0=((size_t)b)*((size_t)blocksize);
+        size_t len=n-i0;
+        if(len>((size_t)blocksize)) len=blocksize;
+        rawlen[b]=len;
+        uLongf zlen=compressBound(len);
+        stored[b].resize(zlen);
+        int ret=compress2(&(stored[b][0]),&zlen,
+                (const Bytef *)(&(raw[i0])),len,level);
+        if(ret!=Z_OK)
+        {
+#pragma omp critical
+            zfailed=true;
+        }
+        else if(zlen>=len)
+        {
+            /* Incompressible - store the raw bytes */
+            memcpy(&(stored[b][0]),&(raw[i0]),len);
+            storedlen[b]=((uint32_t)len)|BlockStoredFlag;
+        }
+        else
+            storedlen[b]=zlen;
+    }
+    if(zfailed) return false;
+    unsigned char bhdr[8];
+    for(b=0;b<nb;++b)
+    {
+        put32(bhdr,rawlen[b]);
+        put32(bhdr+4,storedlen[b]);
+        out.write((const char *)bhdr,8);
+        out.write((const char *)(&(stored[b][0])),
+                storedlen[b]&(~BlockStoredFlag));
+    }
+    this->setp(&(raw[0]),&(raw[0])+raw.size());
+    return(!out.fail());
+}
+int BlockCompressBuf::overflow(int c)
+{
+    if(finished || failed) return traits_type::eof();
+    if(!this->write_blocks())
+    {
+        failed=true;
+        return traits_type::eof();
+    }
+    if(!traits_type::eq_int_type(c,traits_type::eof()))
+    {
+        *(this->pptr())=traits_type::to_char_type(c);
+        this->pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+int BlockCompressBuf::sync()
+{
+    if(finished) return 0;
+    if(failed || !this->write_blocks())
+    {
+        failed=true;
+        return -1;
+    }
+    out.flush();
+    return 0;
+}
+void BlockCompressBuf::finish()
+{
+    if(finished) return;
+    if(!failed && !this->write_blocks()) failed=true;
+    if(!failed)
+    {
+        unsigned char marker[8];
+        memset(marker,0,8);
+        out.write((const char *)marker,8);
+        out.flush();
+        if(out.fail()) failed=true;
+    }
+    finished=true;
+    this->setp(NULL,NULL);
+    if(failed) throw SeisppError(string("BlockCompressBuf::finish:  ")
+            + "compression or write of compressed output stream failed");
+}
+BlockDecompressBuf::BlockDecompressBuf(istream& is, int nt) : in(is)
+{
+    nthreads=default_threads(nt);
+    at_end=false;
+    position=0;
+    stored.resize(nthreads);
+    this->setg(NULL,NULL,NULL);
+    try {
+        is_compressed=this->read_header(true);
+    }catch(...){throw;};
+}
+/* Reads a stream header if the next byte is the tag.  Returns true if
+   a valid header was read.   For the first header anything read that
+   turns out not to be a header is kept to pass through.  */
+bool BlockDecompressBuf::read_header(bool first)
+{
+    int c=in.peek();
+    if((c==EOF) || !is_block_compression_tag(c)) return false;
+    unsigned char hdr[BlockCompressionHeaderSize];
+    in.read((char *)hdr,BlockCompressionHeaderSize);
+    int n=in.gcount();
+    if((n==BlockCompressionHeaderSize)
+            && (memcmp(hdr,BlockCompressionTag,4)==0))
+    {
+        int version=(int)hdr[4]-(int)'0';
+        if((version<1) || (version>BlockCompressionVersion)
+                || (hdr[5]!=BlockCodecZlib))
+        {
+            stringstream ss;
+            ss << "BlockDecompressBuf:  compressed stream has version "
+                << version<<" and codec "<<(int)hdr[5]<<endl
+                << "This program reads versions 1 to "
+                << BlockCompressionVersion
+                << " with codec "<<BlockCodecZlib<<" (zlib)"<<endl;
+            throw SeisppError(ss.str());
+        }
+        return true;
+    }
+    if(first && (n>0))
+    {
+        buffer.assign((char *)hdr,((char *)hdr)+n);
+        this->setg(&(buffer[0]),&(buffer[0]),&(buffer[0])+n);
+    }
+    return false;
+}
+int BlockDecompressBuf::underflow()
+{
+    if(this->gptr()<this->egptr())
+        return traits_type::to_int_type(*(this->gptr()));
+    position+=(this->egptr()-this->eback());
+    this->setg(NULL,NULL,NULL);
+    if(at_end) return traits_type::eof();
+    if(!is_compressed)
+    {
+        buffer.resize(BlockCompressionBlockSize);
+        streamsize n=in.rdbuf()->sgetn(&(buffer[0]),buffer.size());
+        if(n<=0)
+        {
+            at_end=true;
+            return traits_type::eof();
+        }
+        this->setg(&(buffer[0]),&(buffer[0]),&(buffer[0])+n);
+        return traits_type::to_int_type(buffer[0]);
+    }
+    /* Read up to one block per thread */
+    vector<uint32_t> rawlen,storedlen;
+    int nb(0);
+    unsigned char bhdr[8];
+    while(nb<nthreads)
+    {
+        in.read((char *)bhdr,8);
+        /* A complete stream always ends with a 0 length block so 
+           running out of data here means it was truncated */
+        streamsize n=in.gcount();
+        if(n!=8)
+        {
+            at_end=true;
+            ostringstream message;
+            message << "BlockDecompressBuf::underflow:  "
+                << "compressed stream is truncated at uncompressed position "
+                << position<<endl;
+            if(n==0)
+                message << "End of stream marker is missing"<<endl;
+            else
+                message << "Read "<<n<<" bytes of an 8 byte block header"
+                    <<endl;
+            throw SeisppError(message.str());
+        }
+        uint32_t r=get32(bhdr);
+        uint32_t s=get32(bhdr+4);
+        if(r==0)
+        {
+            /* End of one stream.  Another may be concatenated. */
+            if(!this->read_header(false))
+            {
+                at_end=true;
+                break;
+            }
+            continue;
+        }
+        uint32_t slen=s&(~BlockStoredFlag);
+        /* Validate lengths before they are used to size buffers */
+        if(r>((uint32_t)BlockCompressionMaxBlockSize)
+            || ((s&BlockStoredFlag) && (slen!=r))
+            || (!(s&BlockStoredFlag) 
+                && ((slen==0) || (slen>compressBound(r)))))
+        {
+            at_end=true;
+            ostringstream message;
+            message << "BlockDecompressBuf::underflow:  "
+                << "corrupt block header at uncompressed position "
+                << position<<endl
+                << "raw length="<<r<<" stored length="<<slen;
+            if(s&BlockStoredFlag) message << " (stored block)";
+            message<<endl;
+            throw SeisppError(message.str());
+        }
+        stored[nb].resize(slen);
+        in.read((char *)(&(stored[nb][0])),slen);
+        if(in.gcount()!=slen)
+        {
+            at_end=true;
+            ostringstream message;
+            message << "BlockDecompressBuf::underflow:  "
+                << "compressed stream is truncated at uncompressed position "
+                << position<<endl
+                << "Read "<<in.gcount()<<" of the "<<slen
+                << " bytes of a block"<<endl;
+            throw SeisppError(message.str());
+        }
+        rawlen.push_back(r);
+        storedlen.push_back(s);
+        ++nb;
+    }
+    if(nb==0) return traits_type::eof();
+    vector<size_t> offset(nb+1);
+    offset[0]=0;
+    int b;
+    for(b=0;b<nb;++b) offset[b+1]=offset[b]+rawlen[b];
+    buffer.resize(offset[nb]);
+    bool zfailed(false);
+#pragma omp parallel for schedule(dynamic,1) if(nb>1)
+    for(b=0;b<nb;++b)
+    {
+        Bytef *dest=(Bytef *)(&(buffer[offset[b]]));
+        if(storedlen[b]&BlockStoredFlag)
+            memcpy(dest,&(stored[b][0]),rawlen[b]);
+        else
+        {
+            uLongf dlen=rawlen[b];
+            int ret=uncompress(dest,&dlen,&(stored[b][0]),storedlen[b]);
+            if((ret!=Z_OK) || (dlen!=rawlen[b]))
+            {
+#pragma omp critical
+                zfailed=true;
+            }
+        }
+    }
+    if(zfailed)
+    {
+        at_end=true;
+        ostringstream message;
+        message << "BlockDecompressBuf::underflow:  "
+            << "zlib could not decompress a block between uncompressed "
+            << "positions "<<position<<" and "<<position+offset[nb]<<endl
+            << "Data are corrupt"<<endl;
+        throw SeisppError(message.str());
+    }
+    this->setg(&(buffer[0]),&(buffer[0]),&(buffer[0])+buffer.size());
+    return traits_type::to_int_type(buffer[0]);
+}
+streampos BlockDecompressBuf::seekoff(streamoff off, ios_base::seekdir way,
+        ios_base::openmode which)
+{
+    /* Only the current position (tellg) can be reported */
+    if((off==0) && (way==ios_base::cur) && (which&ios_base::in))
+        return(streampos(position+(this->gptr()-this->eback())));
+    return(streampos(streamoff(-1)));
+}
@@ -0,0 +1,165 @@
+#ifndef _BlockCompression_h_
+#define _BlockCompression_h_
+#include <stdint.h>
+#include <iostream>
+#include <streambuf>
+#include <vector>
+using namespace std;
+/*! \brief Block compressed stream format.
+
+  Serialized outputs of this package (particle motion archives and
+  the seismogram streams passed between filters) are large and
+  usually limited by I/O bandwidth.   This is a simple container
+  that compresses a byte stream in independent blocks with zlib so
+  blocks can be compressed and decompressed by several threads.
+
+  A stream starts with an 8 byte header:  the tag bytes 0x89 S P Z,
+  a version digit, a codec byte (1 is zlib), and 2 zero bytes.  Each
+  block is a 4 byte raw length, a 4 byte stored length, and the
+  stored bytes.   Lengths are little endian.   If the high bit of the
+  stored length is set the block is stored uncompressed.   A raw
+  length of 0 ends the stream.  Compressed streams may be
+  concatenated (e.g. with cat).
+
+  The first tag byte can not start a boost text or binary archive,
+  a PMArchive binary tag, or a text file, so readers can detect
+  compressed input from one byte and read compressed and plain
+  streams the same way.
+  */
+const int BlockCompressionVersion(1);
+/*! Default size of uncompressed blocks */
+const int BlockCompressionBlockSize(1048576);
+/*! \brief Largest allowed size of uncompressed blocks.
+
+  Readers reject blocks with a larger raw length as corrupt so a
+  damaged header can not make them allocate gigabytes. */
+const int BlockCompressionMaxBlockSize(67108864);
+/*! Return true if c is the first byte of a block compressed stream.*/
+bool is_block_compression_tag(int c);
+/*! \brief Stream buffer that block compresses everything written to it.
+
+  Data are collected until there is one block for each thread.  The
+  blocks are then compressed in parallel (OpenMP) and written in
+  order to the output stream.   A flush (sync) writes any partial
+  block so frequent flushes reduce compression.   The end marker is
+  written by finish or the destructor.  */
+class BlockCompressBuf : public streambuf
+{
+public:
+    /*! \brief Constructor.
+
+      \param os stream receiving the compressed data.  Should be
+        opened with ios::binary.  Must exist until finish is called.
+      \param level zlib compression level (1 fastest to 9 smallest).
+      \param nthreads number of blocks compressed at once.  0 means
+        the OpenMP default number of threads.
+      \param blocksize size of uncompressed blocks in bytes
+      \exception SeisppError is thrown if blocksize is not positive
+        or is larger than BlockCompressionMaxBlockSize.
+      */
+    BlockCompressBuf(ostream& os, int level=1, int nthreads=0,
+            int blocksize=BlockCompressionBlockSize);
+    ~BlockCompressBuf();
+    /*! \brief Write all buffered data and the end of stream marker.
+
+      Nothing can be written after this is called.  Called by the
+      destructor if it was not called earlier.
+      \exception SeisppError is thrown if compression or a write
+        failed at any time. */
+    void finish();
+protected:
+    int overflow(int c);
+    int sync();
+private:
+    ostream& out;
+    int level;
+    int nthreads;
+    int blocksize;
+    bool header_written;
+    bool finished;
+    bool failed;
+    vector<char> raw;
+    vector< vector<unsigned char> > stored;
+    bool write_blocks();
+};
+/*! \brief Stream buffer that reads block compressed or plain data.
+
+  The input is checked for the block compression header when this
+  object is constructed.   Compressed input is decompressed one
+  block per thread at a time in parallel.   Anything else is passed
+  through unchanged so callers can read either kind of input.
+  Only sequential reading is supported.   tellg returns the position
+  in the uncompressed data.   Compressed input ends normally only at
+  the end of stream marker the writer appends.   A stream that is 
+  truncated (missing that marker or cut inside a block), a block that
+  zlib can not decompress, or a block header with impossible lengths
+  (a raw length larger than BlockCompressionMaxBlockSize, a stored 
+  block whose length differs from its raw length, or a compressed 
+  length larger than zlib can produce) throws a SeisppError from 
+  underflow.  The istream reading this buffer catches it and sets 
+  badbit unless exceptions were enabled for badbit, in which case it
+  is rethrown to the caller.  Callers should check bad() rather than
+  treat every end of input as normal. */
+class BlockDecompressBuf : public streambuf
+{
+public:
+    /*! \brief Constructor.
+
+      \param is source stream.   Should be opened with ios::binary.
+      \param nthreads number of blocks decompressed at once.  0 means
+        the OpenMP default number of threads.
+      */
+    BlockDecompressBuf(istream& is, int nthreads=0);
+    /*! Return true if the input is block compressed. */
+    bool compressed() const {return is_compressed;};
+protected:
+    int underflow();
+    streampos seekoff(streamoff off, ios_base::seekdir way,
+            ios_base::openmode which=ios_base::in | ios_base::out);
+private:
+    istream& in;
+    int nthreads;
+    bool is_compressed;
+    bool at_end;
+    /* Number of uncompressed bytes before the current buffer */
+    int64_t position;
+    vector<char> buffer;
+    vector< vector<unsigned char> > stored;
+    bool read_header(bool first);
+};
+/*! \brief Output stream that block compresses what is written to it.
+
+  Convenience wrapper for BlockCompressBuf.   The compressed stream
+  is finished when this object is destroyed or finish is called. */
+class BlockCompressOStream : public ostream
+{
+public:
+    BlockCompressOStream(ostream& os, int level=1, int nthreads=0)
+        : ostream(NULL), buf(os,level,nthreads)
+    {
+        this->rdbuf(&buf);
+    };
+    /*! Write buffered data and the end of stream marker. */
+    void finish() {this->flush(); buf.finish();};
+private:
+    BlockCompressBuf buf;
+};
+/*! \brief Input stream that reads block compressed or plain data.
+
+  Convenience wrapper for BlockDecompressBuf.   Use this in place of
+  the raw input stream when reading any archive so compressed and
+  plain files can be read the same way. */
+class BlockDecompressIStream : public istream
+{
+public:
+    BlockDecompressIStream(istream& is, int nthreads=0)
+        : istream(NULL), buf(is,nthreads)
+    {
+        this->rdbuf(&buf);
+    };
+    /*! Return true if the input is block compressed. */
+    bool compressed() const {return buf.compressed();};
+private:
+    BlockDecompressBuf buf;
+};
+#endif
@@ -0,0 +1,42 @@
+#include <ctime>
+#include "CounterRNG.h"
+using namespace std;
+using namespace SEISPP;
+/* 32 bit FNV-1a hash */
+static uint32_t fnv1a(const unsigned char *p, int n, uint32_t h)
+{
+    for(int i=0;i<n;++i)
+    {
+        h^=p[i];
+        h*=16777619u;
+    }
+    return h;
+}
+uint32_t PMRandomSourceKey(Metadata& md)
+{
+    uint32_t h(2166136261u);
+    if(md.is_attribute("sta"))
+    {
+        string sta=md.get_string("sta");
+        h=fnv1a((const unsigned char *)sta.c_str(),sta.size(),h);
+    }
+    /* Separator so sta="A" evid=1 differs from sta="A1" with no evid*/
+    const unsigned char sep(0xff);
+    h=fnv1a(&sep,1,h);
+    if(md.is_attribute("evid"))
+    {
+        long evid=md.get_long("evid");
+        unsigned char b[8];
+        for(int i=0;i<8;++i) b[i]=(unsigned char)(evid>>(8*i));
+        h=fnv1a(b,8,h);
+    }
+    return h;
+}
+uint64_t PMClockSeed()
+{
+    /* Only 63 bits are used so the seed survives storage as a long
+       in Metadata */
+    uint64_t s=(uint64_t)time(NULL);
+    s=s*6364136223846793005ULL+1442695040888963407ULL;
+    return(s>>1);
+}
@@ -0,0 +1,117 @@
+#ifndef _CounterRNG_h_
+#define _CounterRNG_h_
+#include <stdint.h>
+#include <string>
+#include "Metadata.h"
+using namespace std;
+using namespace SEISPP;
+/*! \brief Counter based random number generator for the bootstrap.
+
+  The bootstrap originally used one file scope mt19937 seeded from
+  the clock (see random_array_index).   Results could not be
+  reproduced and the generator can not be shared by threads.  This
+  is the Philox4x32-10 generator of Salmon et al. (2011, Parallel
+  random numbers: as easy as 1, 2, 3).   Output is a fixed function
+  of a 64 bit key and a 128 bit counter, so any number of
+  independent streams can be created from a run seed and a set of
+  logical coordinates with no shared state.  Each bootstrap estimate
+  gets its own stream so results do not depend on the order or the
+  thread in which estimates are computed.
+
+  The key is the run seed.  Counter word 0 counts blocks of four
+  outputs within a stream.  Words 1 to 3 identify the stream.  By
+  convention in this library they are (sample, band, source) where
+  source is from PMRandomSourceKey.
+  */
+class CounterRNG
+{
+public:
+    /*! \brief Create a stream.
+
+      \param seed run seed (the key)
+      \param c1 first stream coordinate (normally sample number)
+      \param c2 second stream coordinate (normally band number)
+      \param c3 third stream coordinate (normally PMRandomSourceKey)
+      */
+    CounterRNG(uint64_t seed, uint32_t c1, uint32_t c2, uint32_t c3)
+    {
+        key[0]=(uint32_t)seed;
+        key[1]=(uint32_t)(seed>>32);
+        ctr[0]=0;
+        ctr[1]=c1;
+        ctr[2]=c2;
+        ctr[3]=c3;
+        nused=4;
+    };
+    /*! Return the next 32 random bits of the stream. */
+    uint32_t next()
+    {
+        if(nused>=4)
+        {
+            this->block();
+            ++ctr[0];
+            nused=0;
+        }
+        return(out[nused++]);
+    };
+    /*! \brief Return a uniformly distributed integer from 0 to range-1.
+
+      Uses Lemire's multiply and shift method with rejection so the
+      result is exactly uniform.   range must be positive. */
+    int bounded(uint32_t range)
+    {
+        uint64_t m=((uint64_t)(this->next()))*((uint64_t)range);
+        uint32_t l=(uint32_t)m;
+        if(l<range)
+        {
+            uint32_t t=((uint32_t)(-range))%range;
+            while(l<t)
+            {
+                m=((uint64_t)(this->next()))*((uint64_t)range);
+                l=(uint32_t)m;
+            }
+        }
+        return((int)(m>>32));
+    };
+    /*! Fill out with n integers from 0 to range-1. */
+    void fill_indices(int range, int n, int *out)
+    {
+        for(int i=0;i<n;++i) out[i]=this->bounded((uint32_t)range);
+    };
+private:
+    uint32_t key[2];
+    uint32_t ctr[4];
+    uint32_t out[4];
+    int nused;
+    /* Computes out from ctr and key - 10 Philox rounds */
+    void block()
+    {
+        const uint32_t M0(0xD2511F53), M1(0xCD9E8D57);
+        const uint32_t W0(0x9E3779B9), W1(0xBB67AE85);
+        uint32_t c0(ctr[0]),c1(ctr[1]),c2(ctr[2]),c3(ctr[3]);
+        uint32_t k0(key[0]),k1(key[1]);
+        for(int r=0;r<10;++r)
+        {
+            uint64_t p0=((uint64_t)M0)*c0;
+            uint64_t p1=((uint64_t)M1)*c2;
+            uint32_t hi0=(uint32_t)(p0>>32), lo0=(uint32_t)p0;
+            uint32_t hi1=(uint32_t)(p1>>32), lo1=(uint32_t)p1;
+            c0=hi1^c1^k0;
+            c1=lo1;
+            c2=hi0^c3^k1;
+            c3=lo0;
+            k0+=W0;
+            k1+=W1;
+        }
+        out[0]=c0; out[1]=c1; out[2]=c2; out[3]=c3;
+    };
+};
+/*! \brief Stream coordinate identifying the source of a set of data.
+
+  Hashes the sta and evid attributes of md (either may be missing) so
+  different stations and events get different bootstrap streams for
+  the same seed, band, and sample. */
+uint32_t PMRandomSourceKey(Metadata& md);
+/*! Return a seed derived from the clock for runs that do not set one.*/
+uint64_t PMClockSeed();
+#endif
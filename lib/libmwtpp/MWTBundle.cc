@@ -36,6 +36,7 @@ MWTBundle::MWTBundle(ThreeComponentSeismogram& d,MWTransform& processor)
            number of bands and wavelets. */
         nw=processor.number_wavelet_pairs();
         nb=processor.number_frequencies();
+        if(processor.edge_trimming()) put("edge_trimmed",true);
     }catch(...){throw;};
 }
 MWTBundle::MWTBundle(TimeSeriesEnsemble& d,MWTransform& processor)
@@ -83,6 +84,7 @@ MWTBundle::MWTBundle(TimeSeriesEnsemble& d,MWTransform& processor)
             + "All ensemble members were either dead or failed processing");
     nw=processor.number_wavelet_pairs();
     nb=processor.number_frequencies();
+    if(processor.edge_trimming()) put("edge_trimmed",true);
 }
 
 MWTBundle::MWTBundle(const MWTBundle& parent)
@@ -185,14 +187,35 @@ MWTwaveform MWTBundle::operator()(int b, int w, int m)
 }
 SEISPP::Complex MWTBundle::operator()(int b, int w, int m, int iz)
 {
-    /* Not the most efficient way to implement this as this
-       requires making a copy of a MWTwaveform, but this 
-       routine is not a high priority at the time of initial
-       development.  Could be changed if this becomes a 
-       bottleneck.*/
     try {
-        MWTwaveform d=this->operator()(b,w,m);
+        MWTwaveform& d=this->waveform(b,w,m);
         return d.s[iz];
     }catch(...){throw;};
 }
-
+MWTwaveform& MWTBundle::waveform(int b, int w, int m)
+{
+    const string base_error("MWTBundle::waveform:  ");
+    if( (m<0) || (m>=mwtdata.size()) )
+    {
+        stringstream ss;
+        ss << "Request for data member="<<m<<" not consistent with "
+            << "MWTBundle size="<<mwtdata.size();
+        throw SeisppError(base_error+ss.str());
+    }
+    try {
+        return mwtdata[m](b,w);
+    }catch(...){throw;};
+}
+long MWTBundle::trim_edges()
+{
+    long nremoved(0);
+    int m,b,w;
+    try {
+        for(m=0;m<mwtdata.size();++m)
+            for(b=0;b<nb;++b)
+                for(w=0;w<nw;++w)
+                    nremoved+=2*(mwtdata[m](b,w).trim_edges());
+        put("edge_trimmed",true);
+        return nremoved;
+    }catch(...){throw;};
+}
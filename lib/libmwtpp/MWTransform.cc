@@ -18,6 +18,7 @@ MWTransform::MWTransform()
     nbasis=0;
     decimators=NULL;
     dec_fac=NULL;
+    trim_edges=false;
 }
 MWTransform::MWTransform(string fname)
 {
@@ -46,6 +47,10 @@ MWTransform::MWTransform(string fname)
     for(i=0;i<nbands;++i)
         freetbl(decimator_definitions[i],free);
     free(decimator_definitions);
+    /* Optional - off unless set in the pf */
+    trim_edges=false;
+    if(pfget_string(pf,"trim_wavelet_edges")!=NULL)
+        trim_edges=pfget_boolean(pf,"trim_wavelet_edges");
 }
 MWTransform::MWTransform(const MWTransform& parent)
 {
@@ -80,6 +85,12 @@ MWTMatrix MWTransform::transform(TimeSeries& d)
     try {
         MWTMatrix result(mwtraw,nbands,nbasis,dynamic_cast<Metadata&>(d));
         free_MWtrace_matrix(mwtraw,0,nbands-1,0,nbasis-1);
+        if(trim_edges)
+        {
+            int j;
+            for(i=0;i<nbands;++i)
+                for(j=0;j<nbasis;++j) result(i,j).trim_edges();
+        }
         return result;
     }catch(...)
     {
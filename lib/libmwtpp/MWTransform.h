@@ -52,6 +52,19 @@ public:
     double get_dt0(){return dt0;};
     double get_decfac(){return decimation_factor;};
     int get_wavelet_length(){return wavelet_length;};
+    /*! \brief Remove samples contaminated by edge effects.
+
+      Samples within half a wavelet length of either end of the
+      waveform are computed from wavelets that extend past the ends
+      of the data.  This removes them and adjusts t0 and ns.  The
+      metadata attributes edge_trimmed and edge_trim_samples record 
+      the trim.   A waveform shorter than one wavelet is left with 
+      zero samples.  Calling this more than once does nothing.
+
+      \return number of samples removed from each end (0 if the
+        waveform was already trimmed).
+      */
+    int trim_edges();
 private:
     /* These attributes are cloned from MWtrace. Other parts of MWtrace
      map to ComplexTimeSeries attributes*/
@@ -200,6 +213,14 @@ public:
     \param n is the wavelet number to be retrieved. 
     */
     vector<SEISPP::Complex> basis(int n);
+    /*! \brief Turn edge trimming of transform output on or off.
+
+      When on the transform method removes samples within half a 
+      wavelet length of the ends of each output waveform 
+      (see MWTwaveform::trim_edges).   The pf constructor sets this 
+      from the optional boolean trim_wavelet_edges.  Default is off.*/
+    void set_edge_trimming(bool onoff){trim_edges=onoff;};
+    bool edge_trimming(){return trim_edges;};
     /*! Assignment operator - will only throw an error.
 
       I have not implemented an assignment operator because the underlying
@@ -219,6 +240,8 @@ private:
     int nbands;
     /* nbands length vector with decimation factors for each band */
     int *dec_fac;
+    /* When true transform output is trimmed to the interior */
+    bool trim_edges;
 };
 /*! \brief A generic bundle of MWTransform data objects. 
  
@@ -274,6 +297,28 @@ public:
       \param i is the time index. 
       */
     SEISPP::Complex operator()(int nb, int nw, int member, int iz);
+    /*! \brief Return a reference to one transform waveform.
+
+      Same as the three argument operator() but returns a reference 
+      to the data stored in the bundle instead of a copy.  Use this
+      when only a few samples are needed.   The reference is invalid 
+      if the bundle is modified or destroyed.
+
+      \param nb is band number
+      \param nw is wavelet number
+      \param member is the index of the member of the bundle.
+      \exception SeisppError is thrown for an invalid index.
+      */
+    MWTwaveform& waveform(int nb, int nw, int member);
+    /*! \brief Trim all waveforms to the fully supported interior.
+
+      Applies MWTwaveform::trim_edges to every waveform in the bundle.
+      Waveforms already trimmed (e.g. by MWTransform) are not changed.
+      Sets the edge_trimmed metadata attribute of the bundle.
+
+      \return total number of samples removed from all waveforms.
+      */
+    long trim_edges();
 private:
     /* This is a 3 vector of outputs of the transform method
        applied to x,y,z components of 3c data. */
@@ -339,4 +384,103 @@ template <class T> T WindowData(T& parent, TimeWindow& tw)
 	}
 	return(result);
 }
+/*! \brief Lightweight window into a time series without copying samples.
+
+  WindowData returns a copy of the parent including its Metadata and
+  gap definitions.  When windows are extracted repeatedly from the 
+  same series (e.g. the windowed particle motion ellipse calculation) 
+  that copy dominates the cost.   This object instead holds a pointer
+  to the parent's sample vector, the offset of the first window sample
+  in the parent, and the window length.   Window samples that fall 
+  outside the parent or inside a gap read as zero as they would in 
+  the output of WindowData.  (One difference:  WindowData marks the 
+  edge gaps of a window extending past the ends of the parent with 
+  closed intervals and so also zeros the first or last parent sample.
+  The view keeps those samples.)  A gap mask is only built 
+  when the parent has a gap inside the window so construction is 
+  normally O(1).
+
+  The view is only valid as long as the parent exists and its sample
+  vector is not resized.   The template arguments are the series
+  type (e.g. ComplexTimeSeries) and its sample type (SEISPP::Complex).
+  */
+template <class T, class S> class WindowView
+{
+public:
+    /*! Number of samples in the window */
+    int ns;
+    /*! Time of first sample of the window and sample interval*/
+    double t0,dt;
+    /*! \brief Construct a view.
+
+      \param parent is the series to be windowed.
+      \param tw is the time window.   Semantics are the same as 
+        WindowData.
+      A parent that is marked dead or has no samples gives an empty
+      view (ns 0).
+      \exception SeisppError is thrown if tw does not overlap parent.
+      */
+    WindowView(T& parent, TimeWindow& tw);
+    /*! Return window sample i (0 if outside parent or in a gap).
+      No range checking is done on i. */
+    S operator[](int i) const
+    {
+        if( (i<ifirst) || (i>ilast) ) return(S(0));
+        if(mask.size()>0)
+            if(mask[i]) return(S(0));
+        return(data[offset+i]);
+    };
+    /*! Return true if sample i was not taken from parent data. */
+    bool is_gap(int i) const
+    {
+        if( (i<ifirst) || (i>ilast) ) return(true);
+        if(mask.size()>0) return(mask[i]);
+        return(false);
+    };
+private:
+    const S *data;
+    /* Parent sample number of window sample 0.  Can be negative */
+    int offset;
+    /* Range of window samples that lie inside the parent */
+    int ifirst,ilast;
+    /* Empty unless parent has a gap inside the window */
+    vector<bool> mask;
+};
+template <class T, class S> WindowView<T,S>::WindowView(T& parent, 
+        TimeWindow& tw)
+{
+    data=NULL;
+    offset=0;
+    t0=tw.start;
+    dt=parent.dt;
+    /* A dead or empty parent produces an empty window like WindowData */
+    if(!(parent.live) || (parent.ns<=0) || parent.s.empty()) 
+    {
+        ns=0;
+        ifirst=0;
+        ilast=-1;
+        return;
+    }
+    if( (tw.end<parent.t0) || (tw.start>parent.endtime()) )
+    {
+        ostringstream message;
+        message << "WindowView constructor:  "
+                << "Window data mismatch" <<endl
+                << "Requested time window = " << tw.start <<" to "<<tw.end<<endl
+                << "Data time range = "<<parent.t0<<" to "<<parent.endtime()<<endl;
+        throw SeisppError(message.str());
+    }
+    ns=nint( (tw.end - tw.start)/dt) + 1;
+    offset=parent.sample_number(tw.start);
+    data=&(parent.s[0]);
+    ifirst = offset<0 ? -offset : 0;
+    ilast = parent.ns - 1 - offset;
+    if(ilast>(ns-1)) ilast=ns-1;
+    if(parent.is_gap(tw))
+    {
+        mask.resize(ns,false);
+        for(int i=ifirst;i<=ilast;++i)
+            mask[i]=parent.is_gap(offset+i);
+    }
+}
 #endif
@@ -58,3 +58,29 @@ MWTwaveform& MWTwaveform::operator=(const MWTwaveform& parent)
     }
     return(*this);
 }
+int MWTwaveform::trim_edges()
+{
+    if(this->is_attribute("edge_trimmed"))
+        if(this->get_bool("edge_trimmed")) return 0;
+    /* wavelet_length is in samples of this band */
+    int nh=wavelet_length/2;
+    if(nh>0)
+    {
+        if(2*nh>=ns)
+        {
+            s.clear();
+            t0+=((double)nh)*dt;
+            ns=0;
+        }
+        else
+        {
+            s.erase(s.end()-nh,s.end());
+            s.erase(s.begin(),s.begin()+nh);
+            t0+=((double)nh)*dt;
+            ns-=2*nh;
+        }
+    }
+    put("edge_trimmed",true);
+    put("edge_trim_samples",nh);
+    return nh;
+}
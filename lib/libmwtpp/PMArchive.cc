@@ -0,0 +1,149 @@
+#include <string.h>
+#include <sstream>
+#include "PMArchive.h"
+using namespace std;
+using namespace SEISPP;
+/* Tag written ahead of binary archives.  The last character is the
+   framing version digit. */
+const char PMBinaryTag[]="PMTSBIN";
+const int PMBinaryTagLength(8);
+PMArchiveFormat PMArchiveFormatFromName(const string name)
+{
+    if(name=="text")
+        return PMTextArchive;
+    else if(name=="binary")
+        return PMBinaryArchive;
+    else
+        throw SeisppError(string("PMArchiveFormatFromName:  ")
+                + "unknown archive format="+name
+                + "\nMust be text or binary");
+}
+string PMArchiveFormatName(PMArchiveFormat f)
+{
+    if(f==PMBinaryArchive)
+        return string("binary");
+    else
+        return string("text");
+}
+PMArchiveWriter::PMArchiveWriter(ostream& os, PMArchiveFormat f,
+        bool compress)
+{
+    fmt=f;
+    toa=NULL;
+    boa=NULL;
+    zout=NULL;
+    out=&os;
+    try {
+        ostream *aout(&os);
+        if(compress)
+        {
+            zout=new BlockCompressOStream(os);
+            aout=zout;
+        }
+        if(fmt==PMBinaryArchive)
+        {
+            aout->write(PMBinaryTag,PMBinaryTagLength-1);
+            aout->put((char)('0'+PMBinaryArchiveVersion));
+            boa=new boost::archive::binary_oarchive(*aout);
+        }
+        else
+            toa=new boost::archive::text_oarchive(*aout);
+    }catch(...)
+    {
+        if(zout!=NULL) delete zout;
+        throw;
+    };
+}
+void PMArchiveWriter::finish()
+{
+    /* Deleting the archive writes anything it holds */
+    if(toa!=NULL)
+    {
+        delete toa;
+        toa=NULL;
+    }
+    if(boa!=NULL)
+    {
+        delete boa;
+        boa=NULL;
+    }
+    try {
+        if(zout!=NULL) zout->finish();
+    }catch(...){throw;};
+    out->flush();
+    if(out->fail()) throw SeisppError(string("PMArchiveWriter::finish:  ")
+            + "write error on output stream");
+}
+PMArchiveWriter::~PMArchiveWriter()
+{
+    /* Deleting the archive flushes it, so this must happen before the
+       caller closes the stream */
+    if(toa!=NULL) delete toa;
+    if(boa!=NULL) delete boa;
+    /* Finishes the compressed stream */
+    if(zout!=NULL) delete zout;
+}
+PMArchiveReader::PMArchiveReader(istream& is)
+{
+    const string base_error("PMArchiveReader constructor:  ");
+    tia=NULL;
+    bia=NULL;
+    zin=NULL;
+    in=&is;
+    try {
+        if(is_block_compression_tag(is.peek()))
+        {
+            zin=new BlockDecompressIStream(is);
+            in=zin;
+        }
+        /* A text archive starts with the length of the boost signature
+           string so it can never start with the tag */
+        if(in->peek()==PMBinaryTag[0])
+        {
+            char tag[PMBinaryTagLength];
+            in->read(tag,PMBinaryTagLength);
+            if((in->gcount()!=PMBinaryTagLength)
+                || strncmp(tag,PMBinaryTag,PMBinaryTagLength-1))
+                throw SeisppError(base_error
+                    + "input is neither a text nor a binary PM archive");
+            int version=(int)(tag[PMBinaryTagLength-1]-'0');
+            if((version<1) || (version>PMBinaryArchiveVersion))
+            {
+                stringstream ss;
+                ss << base_error << "binary archive version "<<version
+                    << " is not supported"<<endl
+                    << "This program reads versions 1 to "
+                    << PMBinaryArchiveVersion<<endl;
+                throw SeisppError(ss.str());
+            }
+            fmt=PMBinaryArchive;
+            bia=new boost::archive::binary_iarchive(*in);
+        }
+        else
+        {
+            fmt=PMTextArchive;
+            tia=new boost::archive::text_iarchive(*in);
+        }
+    }catch(...)
+    {
+        if(zin!=NULL) delete zin;
+        throw;
+    };
+}
+PMArchiveReader::~PMArchiveReader()
+{
+    if(tia!=NULL) delete tia;
+    if(bia!=NULL) delete bia;
+    if(zin!=NULL) delete zin;
+}
+bool PMArchiveReader::eof()
+{
+    /* Text archives end with a newline */
+    if(fmt==PMTextArchive) (*in) >> ws;
+    int c=in->peek();
+    /* A corrupt or truncated compressed stream sets badbit.  That must
+       not look like a normal end of the archive. */
+    if(in->bad()) throw SeisppError(string("PMArchiveReader::eof:  ")
+            + "read error on input stream");
+    return(c==EOF);
+}
@@ -0,0 +1,155 @@
+#ifndef _PMArchive_h_
+#define _PMArchive_h_
+#include <iostream>
+#include <string>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include "PMTimeSeries.h"
+#include "PMTimeFrequencyGrid.h"
+#include "BlockCompression.h"
+using namespace std;
+using namespace SEISPP;
+/*! Storage formats for serialized particle motion objects. */
+enum PMArchiveFormat {PMTextArchive, PMBinaryArchive};
+/*! \brief Convert a format name to the enum.
+
+  Accepted names are text and binary.
+  \exception SeisppError is thrown for any other name. */
+PMArchiveFormat PMArchiveFormatFromName(const string name);
+/*! Return the name of a format as accepted by PMArchiveFormatFromName.*/
+string PMArchiveFormatName(PMArchiveFormat f);
+/*! Version of the binary archive framing written by PMArchiveWriter. */
+const int PMBinaryArchiveVersion(1);
+/*! \brief Writes particle motion objects in a selectable format.
+
+  The text format is a plain boost text archive and is identical to
+  what programs in this package wrote before the binary format existed.
+  The binary format is a boost binary archive preceded by an 8 byte
+  tag (PMTSBIN followed by the digit PMBinaryArchiveVersion) so
+  readers can recognize it.  Numeric data are written as raw machine
+  words.   With the columnar storage of PMTimeSeries each column is
+  written as one block so files are several times smaller than text
+  and need no parsing.   The price is that binary files are only
+  readable on machines with the same byte order and type sizes.
+  boost checks this when the file is opened and throws an exception
+  on a mismatch.
+
+  Either format can optionally be block compressed (see 
+  BlockCompression.h).  Compression is done by several threads and 
+  readers detect it so compressed files need no special handling.
+
+  Any number of objects may be written to one writer.  They must be
+  read back in the same order with one PMArchiveReader.  The stream
+  must stay open for the life of the writer.  For the binary format
+  or compression the stream should be opened with ios::binary.
+  */
+class PMArchiveWriter
+{
+public:
+    /*! \brief Start an archive on an output stream.
+
+      \param os stream to write to
+      \param f format of the archive
+      \param compress if true the archive is block compressed.  The 
+        compressed stream is finished by finish or when the writer 
+        is destroyed.
+      */
+    PMArchiveWriter(ostream& os, PMArchiveFormat f=PMTextArchive,
+            bool compress=false);
+    ~PMArchiveWriter();
+    /*! Return the format being written. */
+    PMArchiveFormat format() const {return fmt;};
+    /*! \brief Write one object.
+
+      T can be any type with a boost serialize method, but this is
+      intended for PMTimeSeries and PMTimeFrequencyGrid. */
+    template <class T> void write(T& d)
+    {
+        if((toa==NULL) && (boa==NULL))
+            throw SeisppError(string("PMArchiveWriter::write:  ")
+                    + "archive was already finished");
+        if(fmt==PMBinaryArchive)
+            (*boa) << d;
+        else
+            (*toa) << d;
+    };
+    /*! \brief Write everything and end the archive.
+
+      The destructor does the same but can not report errors, so call
+      this before closing the stream to find out if the output is 
+      complete (e.g. the disk did not fill).  Nothing can be written 
+      after this is called.
+
+      \exception SeisppError is thrown if compression or any write 
+        to the output stream failed. */
+    void finish();
+private:
+    ostream *out;
+    PMArchiveFormat fmt;
+    boost::archive::text_oarchive *toa;
+    boost::archive::binary_oarchive *boa;
+    BlockCompressOStream *zout;
+    /* Archives can not be copied */
+    PMArchiveWriter(const PMArchiveWriter& parent);
+    PMArchiveWriter& operator=(const PMArchiveWriter& parent);
+};
+/*! \brief Reads particle motion objects in any format.
+
+  The format and block compression are detected from the first bytes
+  of the stream when the reader is constructed so callers need not
+  know how a file was written.   Detection only peeks at one 
+  character before a tag so it works on pipes.   Text archives 
+  written before the binary format existed are read as before.
+  */
+class PMArchiveReader
+{
+public:
+    /*! \brief Start reading an archive.
+
+      \param is stream to read from.  Should be opened with ios::binary
+        since the format is not known in advance.
+      \exception SeisppError is thrown if the stream has a binary
+        archive tag with a version newer than this code can read.
+        boost::archive::archive_exception is thrown if the boost
+        archive header is invalid.
+      */
+    PMArchiveReader(istream& is);
+    ~PMArchiveReader();
+    /*! Return the format of the archive being read. */
+    PMArchiveFormat format() const {return fmt;};
+    /*! Return true if the archive is block compressed. */
+    bool compressed() const {return(zin!=NULL);};
+    /*! \brief Return true if there are no more objects in the stream.
+
+      \exception SeisppError is thrown if the stream had a read error
+        such as a truncated or corrupt compressed stream. */
+    bool eof();
+    /*! \brief Return the current read position.
+
+      This is the position in the uncompressed data if the archive is
+      compressed. */
+    streampos tell() {return(in->tellg());};
+    /*! \brief Read one object.
+
+      \exception boost::archive::archive_exception is thrown on a read
+        error, including an attempt to read past the last object. */
+    template <class T> void read(T& d)
+    {
+        if(fmt==PMBinaryArchive)
+            (*bia) >> d;
+        else
+            (*tia) >> d;
+    };
+private:
+    /* Stream the archive reads - zin if compressed */
+    istream *in;
+    BlockDecompressIStream *zin;
+    PMArchiveFormat fmt;
+    boost::archive::text_iarchive *tia;
+    boost::archive::binary_iarchive *bia;
+    PMArchiveReader(const PMArchiveReader& parent);
+    PMArchiveReader& operator=(const PMArchiveReader& parent);
+};
+#endif
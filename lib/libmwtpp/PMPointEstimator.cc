@@ -0,0 +1,177 @@
+#include <math.h>
+#include <string.h>
+#include "PMPointEstimator.h"
+using namespace std;
+using namespace SEISPP;
+PMPointEstimator::PMPointEstimator(MWTBundle& d, int b, double conf,
+        int bsmultiplier, int avlen, long seed) : bundle(d)
+{
+    const string base_error("PMPointEstimator constructor:  ");
+    if(d.number_members() != 3)
+    {
+        stringstream ss;
+        ss << "Bundle size passed = "<<d.number_members()<<endl
+            << "This must be exactly 3 - likely coding error"<<endl;
+        throw SeisppError(base_error + ss.str());
+    }
+    if((b<0) || (b>=d.number_bands()))
+    {
+        stringstream ss;
+        ss << "Illegal request for band="<<b<<endl
+            << "band requested must be between 0 and "<<d.number_bands()-1<<endl;
+        throw SeisppError(base_error+ss.str());
+    }
+    try {
+        band=b;
+        nw=d.number_wavelets();
+        confidence=conf;
+        ntrials=bsmultiplier*nw;
+        averaging_length=avlen;
+        f0=d.get_f0(band);
+        fw=d.get_fw(band);
+        wavelet_duration=(d.sample_interval(band))
+                         *((double)(d.get_wavelet_length(band)));
+        MWTwaveform& x=bundle.waveform(band,0,0);
+        t0=x.t0;
+        dt=x.dt;
+        ns=x.ns;
+        /* Same definition as the PMTimeSeries time averaging constructor */
+        if(avlen>1)
+            time_avlen=x.get_dt0()*((double)avlen);
+        else
+            time_avlen=0.0;
+        if(seed>0)
+            rng_seed=(uint64_t)seed;
+        else
+            rng_seed=PMClockSeed();
+        rng_source=PMRandomSourceKey(dynamic_cast<Metadata&>(d));
+    }catch(...){throw;};
+}
+double PMPointEstimator::starttime()
+{
+    return(t0+time_avlen/2.0);
+}
+double PMPointEstimator::endtime()
+{
+    return(t0+dt*((double)(ns-1))-time_avlen/2.0);
+}
+/* Random stream coordinate for a query time - folds the bits of t */
+static uint32_t time_key(double t)
+{
+    uint64_t bits;
+    memcpy(&bits,&t,sizeof(double));
+    return((uint32_t)bits ^ (uint32_t)(bits>>32));
+}
+/* Interpolates between transform coefficients c0 and c1 with weight
+   w1 on c1.  Amplitude and phase are interpolated separately.  The 
+   phase change is taken as the principal value of the rotation from 
+   c0 to c1 which is correct when the phase rotates less than half a
+   cycle per sample.  Linear interpolation of the complex values would
+   shrink the amplitude between samples when the phase rotates. */
+static SEISPP::Complex polar_interpolate(const SEISPP::Complex& c0,
+        const SEISPP::Complex& c1, double w1)
+{
+    double a0=abs(c0);
+    double a1=abs(c1);
+    /* Phase is undefined for a zero coefficient */
+    if((a0<=0.0) || (a1<=0.0)) return((1.0-w1)*c0+w1*c1);
+    double dphi=arg(c1/c0);
+    return(polar((1.0-w1)*a0+w1*a1,arg(c0)+w1*dphi));
+}
+bool PMPointEstimator::wavelet_ellipses(double t,
+        vector<ParticleMotionEllipse>& pmw)
+{
+    if(ns<=0) return false;
+    if( (t<this->starttime()) || (t>this->endtime()) ) return false;
+    double up[3]={0.0,0.0,1.0};
+    int iw,k;
+    pmw.clear();
+    if(time_avlen>0.0)
+    {
+        TimeWindow tw(t-time_avlen/2.0,t+time_avlen/2.0);
+        for(iw=0;iw<nw;++iw)
+            pmw.push_back(ParticleMotionEllipse(bundle.waveform(band,iw,0),
+                bundle.waveform(band,iw,1),bundle.waveform(band,iw,2),
+                tw,up));
+    }
+    else
+    {
+        /* Interpolation between samples j and j+1 */
+        double tj=(t-t0)/dt;
+        int j=(int)floor(tj);
+        double w1=tj-((double)j);
+        if(j>=(ns-1))
+        {
+            j=ns-1;
+            w1=0.0;
+        }
+        for(iw=0;iw<nw;++iw)
+        {
+            SEISPP::Complex c[3];
+            for(k=0;k<3;++k)
+            {
+                MWTwaveform& x=bundle.waveform(band,iw,k);
+                if(x.is_gap(t)) return false;
+                if(w1>0.0)
+                    c[k]=polar_interpolate(x.s[j],x.s[j+1],w1);
+                else
+                    c[k]=x.s[j];
+            }
+            pmw.push_back(ParticleMotionEllipse(c[0],c[1],c[2],up));
+        }
+    }
+    return true;
+}
+void PMPointEstimator::estimate(double t, ParticleMotionEllipse& pme,
+        ParticleMotionError& err)
+{
+    const string base_error("PMPointEstimator::estimate:  ");
+    vector<ParticleMotionEllipse> pmw;
+    pmw.reserve(nw);
+    try {
+        if(!this->wavelet_ellipses(t,pmw))
+        {
+            stringstream ss;
+            ss << "Cannot compute estimate at time "<<t<<endl
+                << "Valid time range for band "<<band<<" is "
+                << this->starttime()<<" to "<<this->endtime()
+                << " excluding data gaps"<<endl;
+            throw SeisppError(base_error+ss.str());
+        }
+        CounterRNG rng(rng_seed,time_key(t),(uint32_t)band,rng_source);
+        ComputePMStats(pmw,pme,err,confidence,ntrials,rng);
+    }catch(...){throw;};
+}
+PMColumns PMPointEstimator::estimate(const vector<double>& t)
+{
+    PMColumns result;
+    int nt=t.size();
+    result.reserve(nt);
+    vector<ParticleMotionEllipse> pmw;
+    pmw.reserve(nw);
+    ParticleMotionEllipse pme;
+    ParticleMotionError err;
+    /* Reused for all times so the bootstrap allocates only once */
+    PMStatsWorkspace work;
+    const PMTimeSeriesControl defaults;
+    try {
+        for(int i=0;i<nt;++i)
+        {
+            if(this->wavelet_ellipses(t[i],pmw))
+            {
+                CounterRNG rng(rng_seed,time_key(t[i]),(uint32_t)band,
+                        rng_source);
+                ComputePMStats(&(pmw[0]),nw,1,pme,err,confidence,ntrials,
+                        rng,defaults,work);
+                result.push_back(pme,err);
+            }
+            else
+            {
+                /* Default constructors give zeros and estimated false*/
+                result.push_back(ParticleMotionEllipse(),
+                        ParticleMotionError());
+            }
+        }
+        return result;
+    }catch(...){throw;};
+}
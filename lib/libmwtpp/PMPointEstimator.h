@@ -0,0 +1,118 @@
+#ifndef _PMPointEstimator_h_
+#define _PMPointEstimator_h_
+#include <vector>
+#include "MWTransform.h"
+#include "ParticleMotionEllipse.h"
+#include "ParticleMotionError.h"
+#include "PMTimeSeries.h"
+using namespace SEISPP;
+/*! \brief Compute particle motion estimates at a list of times.
+
+  A PMTimeSeries computes ellipses and bootstrap errors at every
+  sample of a band.  That is wasteful when the estimates are only
+  needed at a few times such as arrival picks.  This object computes
+  the same estimates only at requested times so the cost scales
+  with the number of queries instead of the window length.
+
+  The estimator keeps a reference to the MWTBundle used to create it
+  and reads the transform data in place.  The bundle must not be
+  modified or destroyed while the estimator is in use.
+
+  With an averaging length of 1 or less estimates match those of the
+  PMTimeSeries sample by sample constructor.  The ellipse for each 
+  wavelet is computed from the transform coefficients at the query 
+  time.  Those are interpolated between the (decimated) samples of 
+  the band with amplitude and phase interpolated separately.  Linear
+  interpolation of the complex values would bias ellipse amplitudes
+  low between samples because the phase rotates.  The phase change 
+  between samples is assumed to be less than half a cycle (the 
+  shorter rotation is used).  Estimates at sample times are exact.
+
+  With a longer averaging length each wavelet ellipse is computed 
+  from a window of that many samples (in units of the original data 
+  sample interval) centered on the query time.  The algorithm is the 
+  same as the PMTimeSeries time averaging constructor but the time 
+  assigned to an estimate is not.   That constructor labels each 
+  estimate with a time half the averaging length before the start of
+  its window, so its sample at time t is the estimate this object 
+  returns for time t plus the averaging length.
+  */
+class PMPointEstimator
+{
+public:
+    /*! \brief Primary constructor.
+
+      \param d transformed data.  d must be a 3C bundle.
+      \param band frequency band to use
+      \param confidence confidence level for the bootstrap errors
+      \param bsmultiplier the number of bootstrap trials is this
+        number times the number of wavelets.
+      \param avlen averaging length in samples of the original data.
+         1 or less means sample by sample estimates.
+      \param seed seed for the bootstrap random streams (see 
+         CounterRNG).  The stream for each estimate is keyed by the 
+         query time so the same query gives the same result.  0 means
+         derive a seed from the clock.
+
+      \exception SeisppError is thrown if d is not a 3C bundle or
+        band is not valid.
+      */
+    PMPointEstimator(MWTBundle& d, int band, double confidence=0.95,
+            int bsmultiplier=100, int avlen=1, long seed=0);
+    /*! \brief Compute estimates at one time.
+
+      \param t time of the estimate (same time base as the bundle)
+      \param pme is set to the bootstrap average ellipse
+      \param err is set to the bootstrap error estimates
+
+      \exception SeisppError is thrown if the estimate at t
+        requires data outside the band or inside a data gap.
+      */
+    void estimate(double t, ParticleMotionEllipse& pme,
+            ParticleMotionError& err);
+    /*! \brief Compute estimates at a list of times.
+
+      Returns one ellipse and error estimate for each time in t in
+      the same order.  Times where an estimate can not be computed
+      (outside the band or in a gap) have zero ellipse and error
+      values and the estimated column set false.   Use that column
+      to sort out which times are valid.
+      */
+    PMColumns estimate(const vector<double>& t);
+    /*! Return the start time of the range of valid query times.*/
+    double starttime();
+    /*! Return the end time of the range of valid query times.*/
+    double endtime();
+    double get_f0(){return f0;};
+    double get_fw(){return fw;};
+    double get_wavelet_duration(){return wavelet_duration;};
+    /*! Return the bootstrap seed actually used. */
+    long get_seed(){return (long)rng_seed;};
+    /*! \brief Compute the ellipse for each wavelet at time t.
+
+      This is the first step of estimate without the bootstrap.  
+      pmw is cleared and filled with one ellipse per wavelet.  
+
+      \return false if t is outside the valid range or in a gap. 
+        pmw is not usable in that case.
+      */
+    bool wavelet_ellipses(double t, vector<ParticleMotionEllipse>& pmw);
+private:
+    MWTBundle& bundle;
+    int band;
+    int nw;
+    double confidence;
+    int ntrials;
+    int averaging_length;
+    /* Averaging window length in s.  0 for sample by sample. */
+    double time_avlen;
+    double f0,fw;
+    double wavelet_duration;
+    /* Time base of the band (common to all wavelets) */
+    double t0,dt;
+    int ns;
+    /* Bootstrap random stream coordinates */
+    uint64_t rng_seed;
+    uint32_t rng_source;
+};
+#endif
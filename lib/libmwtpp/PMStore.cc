@@ -0,0 +1,450 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sstream>
+#include "PMStore.h"
+#include "PMArchive.h"
+using namespace std;
+using namespace SEISPP;
+/* Index file header is the tag, a version digit, the record size, and
+   4 bytes of padding so records start 8 byte aligned */
+const char PMStoreTag[]="PMSTORE";
+const int PMStoreVersion(1);
+const int PMStoreHeaderSize(16);
+const string PMStoreIndexFile("pmstore.index");
+const string PMStoreHeaderFile("pmstore.hdr");
+/* Column files in the order of the PMColumns attributes.   The first
+   15 are double, the next 6 are 32 bit int, and estimated is one byte
+   per sample. */
+const int PMStoreNColumns(22);
+const int PMStoreNDouble(15);
+const int PMStoreNInt(6);
+static const char *column_names[PMStoreNColumns]={"major0","major1",
+    "major2","minor0","minor1","minor2","majornrm","minornrm",
+    "dtheta_major","dphi_major","dtheta_minor","dphi_minor",
+    "dmajornrm","dminornrm","delta_rect","ndgf_major","ndgf_minor",
+    "ndgf_rect","ndgf_major_amp","ndgf_minor_amp","ntrials","estimated"};
+static int column_width(int k)
+{
+    if(k<PMStoreNDouble)
+        return(sizeof(double));
+    else if(k<(PMStoreNDouble+PMStoreNInt))
+        return(sizeof(int32_t));
+    else
+        return(1);
+}
+static string column_path(const string dir, int k)
+{
+    return(dir+"/"+column_names[k]+".col");
+}
+/* Returns the address of the first sample of each column of d except
+   estimated, which is a vector<bool> and has no address. d must not
+   be empty. */
+static void column_addresses(const PMColumns& d, const char **p)
+{
+    int k,n(0);
+    for(k=0;k<3;++k) p[n++]=(const char *)(&(d.major[k][0]));
+    for(k=0;k<3;++k) p[n++]=(const char *)(&(d.minor[k][0]));
+    p[n++]=(const char *)(&(d.majornrm[0]));
+    p[n++]=(const char *)(&(d.minornrm[0]));
+    p[n++]=(const char *)(&(d.dtheta_major[0]));
+    p[n++]=(const char *)(&(d.dphi_major[0]));
+    p[n++]=(const char *)(&(d.dtheta_minor[0]));
+    p[n++]=(const char *)(&(d.dphi_minor[0]));
+    p[n++]=(const char *)(&(d.dmajornrm[0]));
+    p[n++]=(const char *)(&(d.dminornrm[0]));
+    p[n++]=(const char *)(&(d.delta_rect[0]));
+    p[n++]=(const char *)(&(d.ndgf_major[0]));
+    p[n++]=(const char *)(&(d.ndgf_minor[0]));
+    p[n++]=(const char *)(&(d.ndgf_rect[0]));
+    p[n++]=(const char *)(&(d.ndgf_major_amp[0]));
+    p[n++]=(const char *)(&(d.ndgf_minor_amp[0]));
+    p[n++]=(const char *)(&(d.ntrials[0]));
+}
+static string store_key(const string sta, long evid, int band)
+{
+    stringstream ss;
+    ss << sta << ":" << evid << ":" << band;
+    return ss.str();
+}
+static off_t file_size(const string path)
+{
+    struct stat sb;
+    if(stat(path.c_str(),&sb)) return(-1);
+    return(sb.st_size);
+}
+/* Reads all complete records of an index file.  A partial record at
+   the end (left by a writer that died) is ignored.  Returns false if
+   the index file does not exist. */
+static bool read_index(const string dir, vector<PMStoreRecord>& index)
+{
+    const string base_error("PMStore read_index procedure:  ");
+    string path=dir+"/"+PMStoreIndexFile;
+    index.clear();
+    ifstream ifs(path.c_str(),ios::in | ios::binary);
+    if(!ifs) return false;
+    char hdr[PMStoreHeaderSize];
+    ifs.read(hdr,PMStoreHeaderSize);
+    if((ifs.gcount()!=PMStoreHeaderSize)
+            || strncmp(hdr,PMStoreTag,strlen(PMStoreTag)))
+        throw SeisppError(base_error + path
+                + " is not a particle motion store index");
+    int version=(int)(hdr[strlen(PMStoreTag)]-'0');
+    int32_t recsize;
+    memcpy(&recsize,hdr+8,sizeof(int32_t));
+    if((version!=PMStoreVersion) || (recsize!=sizeof(PMStoreRecord)))
+    {
+        stringstream ss;
+        ss << base_error << path << " has version "<<version
+            << " and record size "<<recsize<<endl
+            << "This program reads version "<<PMStoreVersion
+            << " with record size "<<sizeof(PMStoreRecord)<<endl;
+        throw SeisppError(ss.str());
+    }
+    PMStoreRecord r;
+    int64_t nsamp(0);
+    while(ifs.read((char *)(&r),sizeof(PMStoreRecord)))
+    {
+        if(r.offset!=nsamp)
+            throw SeisppError(base_error + path
+                    + " has a record out of sequence");
+        nsamp+=r.ns;
+        index.push_back(r);
+    }
+    return true;
+}
+ParticleMotionEllipse PMColumnsView::get_ellipse(int64_t i) const
+{
+    ParticleMotionEllipse e;
+    for(int k=0;k<3;++k)
+    {
+        e.major[k]=major[k][i];
+        e.minor[k]=minor[k][i];
+    }
+    e.majornrm=majornrm[i];
+    e.minornrm=minornrm[i];
+    return e;
+}
+ParticleMotionError PMColumnsView::get_errors(int64_t i) const
+{
+    ParticleMotionError err;
+    err.dtheta_major=dtheta_major[i];
+    err.dphi_major=dphi_major[i];
+    err.dtheta_minor=dtheta_minor[i];
+    err.dphi_minor=dphi_minor[i];
+    err.dmajornrm=dmajornrm[i];
+    err.dminornrm=dminornrm[i];
+    err.delta_rect=delta_rect[i];
+    err.ndgf_major=ndgf_major[i];
+    err.ndgf_minor=ndgf_minor[i];
+    err.ndgf_rect=ndgf_rect[i];
+    err.ndgf_major_amp=ndgf_major_amp[i];
+    err.ndgf_minor_amp=ndgf_minor_amp[i];
+    err.ntrials=ntrials[i];
+    err.estimated=(estimated[i]!=0);
+    return err;
+}
+PMStore::PMStore(const string dir) : directory(dir)
+{
+    const string base_error("PMStore constructor:  ");
+    try {
+        if(!read_index(dir,index))
+            throw SeisppError(base_error + "no store index in directory "
+                    + dir);
+        int i;
+        nsamp=0;
+        for(i=0;i<index.size();++i)
+        {
+            nsamp+=index[i].ns;
+            keys[store_key(index[i].sta,index[i].evid,index[i].band)]=i;
+        }
+        base.assign(PMStoreNColumns,(char *)NULL);
+        length.assign(PMStoreNColumns,0);
+        for(int k=0;k<PMStoreNColumns;++k)
+        {
+            length[k]=nsamp*column_width(k);
+            if(length[k]==0) continue;
+            string path=column_path(dir,k);
+            if(file_size(path)<((off_t)length[k]))
+                throw SeisppError(base_error + "column file "+path
+                        + " is shorter than the index requires");
+            int fd=open(path.c_str(),O_RDONLY);
+            if(fd<0) throw SeisppError(base_error + "open failed for "
+                    + path);
+            void *p=mmap(NULL,length[k],PROT_READ,MAP_SHARED,fd,0);
+            close(fd);
+            if(p==MAP_FAILED)
+            {
+                length[k]=0;
+                throw SeisppError(base_error + "mmap failed for "+path);
+            }
+            base[k]=(char *)p;
+        }
+        string hdrpath=dir+"/"+PMStoreHeaderFile;
+        hdrfile.open(hdrpath.c_str(),ios::in | ios::binary);
+        if(!hdrfile) throw SeisppError(base_error + "open failed for "
+                + hdrpath);
+    }catch(...)
+    {
+        for(int k=0;k<base.size();++k)
+            if(base[k]!=NULL) munmap(base[k],length[k]);
+        throw;
+    };
+}
+PMStore::~PMStore()
+{
+    for(int k=0;k<base.size();++k)
+        if(base[k]!=NULL) munmap(base[k],length[k]);
+}
+int PMStore::find(const string sta, long evid, int band) const
+{
+    map<string,int>::const_iterator kptr;
+    kptr=keys.find(store_key(sta,evid,band));
+    if(kptr==keys.end())
+        return(-1);
+    else
+        return(kptr->second);
+}
+PMColumnsView PMStore::view_at(int64_t offset, int64_t ns) const
+{
+    PMColumnsView v;
+    int k,n(0);
+    v.ns=ns;
+    for(k=0;k<3;++k) v.major[k]=((const double *)base[n++])+offset;
+    for(k=0;k<3;++k) v.minor[k]=((const double *)base[n++])+offset;
+    v.majornrm=((const double *)base[n++])+offset;
+    v.minornrm=((const double *)base[n++])+offset;
+    v.dtheta_major=((const double *)base[n++])+offset;
+    v.dphi_major=((const double *)base[n++])+offset;
+    v.dtheta_minor=((const double *)base[n++])+offset;
+    v.dphi_minor=((const double *)base[n++])+offset;
+    v.dmajornrm=((const double *)base[n++])+offset;
+    v.dminornrm=((const double *)base[n++])+offset;
+    v.delta_rect=((const double *)base[n++])+offset;
+    v.ndgf_major=((const int32_t *)base[n++])+offset;
+    v.ndgf_minor=((const int32_t *)base[n++])+offset;
+    v.ndgf_rect=((const int32_t *)base[n++])+offset;
+    v.ndgf_major_amp=((const int32_t *)base[n++])+offset;
+    v.ndgf_minor_amp=((const int32_t *)base[n++])+offset;
+    v.ntrials=((const int32_t *)base[n++])+offset;
+    v.estimated=((const unsigned char *)base[n++])+offset;
+    return v;
+}
+PMColumnsView PMStore::view(int i) const
+{
+    if((i<0) || (i>=index.size()))
+    {
+        stringstream ss;
+        ss << "PMStore::view method:  requested series "<<i
+            << " but store has "<<index.size()<<" series"<<endl;
+        throw SeisppError(ss.str());
+    }
+    return(this->view_at(index[i].offset,index[i].ns));
+}
+PMColumnsView PMStore::all() const
+{
+    return(this->view_at(0,nsamp));
+}
+PMTimeSeries PMStore::series(int i)
+{
+    const string base_error("PMStore::series method:  ");
+    try {
+        PMColumnsView v=this->view(i);
+        const PMStoreRecord& r=index[i];
+        string buf(r.hdrsize,'\0');
+        hdrfile.clear();
+        hdrfile.seekg(r.hdroffset);
+        hdrfile.read(&(buf[0]),r.hdrsize);
+        if(hdrfile.gcount()!=r.hdrsize)
+            throw SeisppError(base_error + "read failed for header of "
+                    + store_key(r.sta,r.evid,r.band));
+        istringstream hs(buf);
+        PMArchiveReader ar(hs);
+        Metadata md;
+        BasicTimeSeries bts;
+        ar.read(md);
+        ar.read(bts);
+        PMTimeSeries result;
+        result.Metadata::operator=(md);
+        result.BasicTimeSeries::operator=(bts);
+        result.f0=r.f0;
+        result.fw=r.fw;
+        result.decfac=r.decfac;
+        result.averaging_length=r.averaging_length;
+        result.wavelet_duration=r.wavelet_duration;
+        PMColumns& c=result.pmcols;
+        int n=r.ns;
+        c.resize(n);
+        if(n<=0) return result;
+        const char *p[PMStoreNColumns];
+        column_addresses(c,p);
+        const char *src[PMStoreNColumns];
+        int k;
+        for(k=0;k<(PMStoreNDouble+PMStoreNInt);++k)
+            src[k]=base[k]+r.offset*column_width(k);
+        /* column_addresses returns const pointers for the writer.  The
+           storage belongs to result so the cast is safe. */
+        for(k=0;k<(PMStoreNDouble+PMStoreNInt);++k)
+            memcpy(const_cast<char *>(p[k]),src[k],n*column_width(k));
+        for(k=0;k<n;++k) c.estimated[k]=(v.estimated[k]!=0);
+        return result;
+    }catch(...){throw;};
+}
+PMStoreWriter::PMStoreWriter(const string dir) : directory(dir)
+{
+    const string base_error("PMStoreWriter constructor:  ");
+    try {
+        if(mkdir(dir.c_str(),0775) && (errno!=EEXIST))
+            throw SeisppError(base_error + "cannot create directory "
+                    + dir);
+        vector<PMStoreRecord> index;
+        string indexpath=dir+"/"+PMStoreIndexFile;
+        string hdrpath=dir+"/"+PMStoreHeaderFile;
+        int k;
+        nsamp=0;
+        hdrsize=0;
+        if(read_index(dir,index))
+        {
+            int n=index.size();
+            if(n>0)
+            {
+                nsamp=index[n-1].offset+index[n-1].ns;
+                hdrsize=index[n-1].hdroffset+index[n-1].hdrsize;
+            }
+            /* Discard anything written after the last complete record*/
+            if(truncate(indexpath.c_str(),
+                        PMStoreHeaderSize+n*sizeof(PMStoreRecord)))
+                throw SeisppError(base_error + "truncate failed for "
+                        + indexpath);
+            for(k=0;k<PMStoreNColumns;++k)
+            {
+                string path=column_path(dir,k);
+                off_t need=nsamp*column_width(k);
+                off_t have=file_size(path);
+                if(have<need)
+                    throw SeisppError(base_error + "column file "+path
+                            + " is shorter than the index requires");
+                if((have>need) && truncate(path.c_str(),need))
+                    throw SeisppError(base_error + "truncate failed for "
+                            + path);
+            }
+            off_t have=file_size(hdrpath);
+            if(have<hdrsize)
+                throw SeisppError(base_error + hdrpath
+                        + " is shorter than the index requires");
+            if((have>hdrsize) && truncate(hdrpath.c_str(),hdrsize))
+                throw SeisppError(base_error + "truncate failed for "
+                        + hdrpath);
+            nseries=n;
+            indexfile.open(indexpath.c_str(),
+                    ios::out | ios::app | ios::binary);
+        }
+        else
+        {
+            nseries=0;
+            indexfile.open(indexpath.c_str(),ios::out | ios::binary);
+            char hdr[PMStoreHeaderSize];
+            memset(hdr,0,PMStoreHeaderSize);
+            memcpy(hdr,PMStoreTag,strlen(PMStoreTag));
+            hdr[strlen(PMStoreTag)]=(char)('0'+PMStoreVersion);
+            int32_t recsize=sizeof(PMStoreRecord);
+            memcpy(hdr+8,&recsize,sizeof(int32_t));
+            indexfile.write(hdr,PMStoreHeaderSize);
+            indexfile.flush();
+        }
+        if(indexfile.fail()) throw SeisppError(base_error
+                + "cannot open "+indexpath+" for writing");
+        hdrfile.open(hdrpath.c_str(),ios::out | ios::app | ios::binary);
+        if(hdrfile.fail()) throw SeisppError(base_error
+                + "cannot open "+hdrpath+" for writing");
+        for(k=0;k<PMStoreNColumns;++k)
+        {
+            string path=column_path(dir,k);
+            colfiles.push_back(new ofstream(path.c_str(),
+                        ios::out | ios::app | ios::binary));
+            if(colfiles[k]->fail()) throw SeisppError(base_error
+                    + "cannot open "+path+" for writing");
+        }
+    }catch(...)
+    {
+        for(int k=0;k<colfiles.size();++k) delete colfiles[k];
+        colfiles.clear();
+        throw;
+    };
+}
+PMStoreWriter::~PMStoreWriter()
+{
+    for(int k=0;k<colfiles.size();++k) delete colfiles[k];
+}
+void PMStoreWriter::append(PMTimeSeries& d, int band)
+{
+    const string base_error("PMStoreWriter::append:  ");
+    try {
+        PMStoreRecord r;
+        memset(&r,0,sizeof(PMStoreRecord));
+        string sta=d.get_string("sta");
+        if(sta.size()>=PMStoreStaLength)
+            throw SeisppError(base_error + "station name "+sta
+                    + " is too long for the store index");
+        memcpy(r.sta,sta.c_str(),sta.size()+1);
+        r.evid=d.get_long("evid");
+        if(d.errors_deferred()) d.evaluate_errors();
+        const PMColumns& c=d.pmcols;
+        int n=c.size();
+        int k;
+        if(n>0)
+        {
+            const char *p[PMStoreNColumns];
+            column_addresses(c,p);
+            for(k=0;k<(PMStoreNDouble+PMStoreNInt);++k)
+                colfiles[k]->write(p[k],n*column_width(k));
+            vector<unsigned char> est(n);
+            for(int i=0;i<n;++i) est[i]=(c.estimated[i] ? 1 : 0);
+            colfiles[PMStoreNColumns-1]->write((const char *)(&(est[0])),n);
+        }
+        /* Metadata and time base (including gaps) as a binary archive*/
+        ostringstream hs;
+        {
+            PMArchiveWriter ar(hs,PMBinaryArchive);
+            Metadata md(d);
+            BasicTimeSeries bts(d);
+            ar.write(md);
+            ar.write(bts);
+        }
+        string hbuf=hs.str();
+        hdrfile.write(hbuf.c_str(),hbuf.size());
+        /* Everything the record points to must be on disk first */
+        hdrfile.flush();
+        bool failed(hdrfile.fail());
+        for(k=0;k<PMStoreNColumns;++k)
+        {
+            colfiles[k]->flush();
+            if(colfiles[k]->fail()) failed=true;
+        }
+        if(failed) throw SeisppError(base_error
+                + "write failed in store directory "+directory);
+        r.band=band;
+        r.ns=n;
+        r.offset=nsamp;
+        r.hdroffset=hdrsize;
+        r.hdrsize=hbuf.size();
+        r.t0=d.t0;
+        r.dt=d.dt;
+        r.f0=d.f0;
+        r.fw=d.fw;
+        r.wavelet_duration=d.wavelet_duration;
+        r.decfac=d.decfac;
+        r.averaging_length=d.averaging_length;
+        indexfile.write((const char *)(&r),sizeof(PMStoreRecord));
+        indexfile.flush();
+        if(indexfile.fail()) throw SeisppError(base_error
+                + "index write failed in store directory "+directory);
+        nsamp+=n;
+        hdrsize+=hbuf.size();
+        ++nseries;
+    }catch(...){throw;};
+}
@@ -0,0 +1,192 @@
+#ifndef _PMStore_h_
+#define _PMStore_h_
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include "PMTimeSeries.h"
+using namespace std;
+using namespace SEISPP;
+/*! Maximum station name length (including the terminating 0) in a
+  PMStore index. */
+const int PMStoreStaLength(16);
+/*! \brief Index entry for one PMTimeSeries in a PMStore.
+
+  Records are stored in the index file exactly as laid out here.
+  All members are naturally aligned so the layout is the same on all
+  common 64 bit compilers. */
+struct PMStoreRecord
+{
+    /*! Station name, 0 terminated */
+    char sta[PMStoreStaLength];
+    /*! Band number of the transform */
+    int32_t band;
+    /*! Number of samples */
+    int32_t ns;
+    int64_t evid;
+    /*! Sample number of the first sample in the column files */
+    int64_t offset;
+    /*! Byte offset and size of the header (Metadata and time base)
+      in the header file */
+    int64_t hdroffset,hdrsize;
+    double t0,dt;
+    double f0,fw;
+    double wavelet_duration;
+    int32_t decfac;
+    int32_t averaging_length;
+};
+/*! \brief Read only view of a block of samples in a PMStore.
+
+  Has the same attributes as PMColumns but each is a pointer into
+  memory mapped column files, so creating a view copies nothing.
+  Element i of each array is sample i of the block.  estimated is
+  stored as one byte per sample (0 or 1).  A view is only valid
+  while the PMStore that created it exists.  */
+class PMColumnsView
+{
+public:
+    /* 64 bit because a view of a whole store can exceed 2^31 samples */
+    int64_t ns;
+    const double *major[3];
+    const double *minor[3];
+    const double *majornrm,*minornrm;
+    const double *dtheta_major,*dphi_major,*dtheta_minor,*dphi_minor;
+    const double *dmajornrm,*dminornrm,*delta_rect;
+    const int32_t *ndgf_major,*ndgf_minor,*ndgf_rect,*ndgf_major_amp,
+        *ndgf_minor_amp;
+    const int32_t *ntrials;
+    const unsigned char *estimated;
+    /*! Return number of samples in the view. */
+    int64_t size() const {return ns;};
+    /*! Gather sample i into a ParticleMotionEllipse.  No range checking.*/
+    ParticleMotionEllipse get_ellipse(int64_t i) const;
+    /*! Gather sample i into a ParticleMotionError.  No range checking.*/
+    ParticleMotionError get_errors(int64_t i) const;
+};
+/*! \brief Store for large numbers of PMTimeSeries objects.
+
+  dbmwpm originally wrote one archive file per seismogram.  Analyses
+  over a full catalog then have to open and parse thousands of small
+  files.   A store packs any number of PMTimeSeries into one
+  directory:
+
+  pmstore.index - a 16 byte header (PMSTORE tag, version digit, and
+    the record size) followed by one PMStoreRecord per series.
+
+  pmstore.hdr - Metadata and BasicTimeSeries attributes of each series
+    as binary boost archives.   Only needed to rebuild full
+    PMTimeSeries objects.
+
+  One file per PMColumns attribute (majornrm.col, dtheta_major.col,
+    etc.) holding that attribute of every series end to end as raw
+    machine words.
+
+  The reader maps the column files into memory so scanning one
+  attribute over the whole catalog is a sequential read of one file
+  and views of single series copy nothing.   Files use the byte order
+  of the machine that wrote them.
+
+  Series are found by sta, evid, and band.  If the same key was
+  appended more than once the last one appended is used.
+  */
+class PMStore
+{
+public:
+    /*! \brief Open a store for reading.
+
+      \param dir directory containing the store
+      \exception SeisppError is thrown if the store can not be opened
+        or is inconsistent.
+      */
+    PMStore(const string dir);
+    ~PMStore();
+    /*! Return number of series in the store. */
+    int number_series() const {return index.size();};
+    /*! Return total number of samples of all series. */
+    int64_t total_samples() const {return nsamp;};
+    /*! \brief Find a series.
+
+      \return index of the series with this sta, evid, and band
+        or -1 if there is none. */
+    int find(const string sta, long evid, int band) const;
+    /*! Return the index record of series i.  No range checking. */
+    const PMStoreRecord& record(int i) const {return index[i];};
+    /*! \brief Return a view of series i.
+
+      \exception SeisppError is thrown if i is out of range. */
+    PMColumnsView view(int i) const;
+    /*! \brief Return a view of all samples of all series.
+
+      Series are stored end to end in the order they were appended.
+      Series i starts at record(i).offset. */
+    PMColumnsView all() const;
+    /*! \brief Return a full copy of series i.
+
+      Reads the header of the series and copies its columns into a
+      new PMTimeSeries.
+
+      \exception SeisppError is thrown if i is out of range or the
+        header can not be read. */
+    PMTimeSeries series(int i);
+private:
+    string directory;
+    vector<PMStoreRecord> index;
+    map<string,int> keys;
+    int64_t nsamp;
+    /* Mapped column files and their lengths in bytes */
+    vector<char *> base;
+    vector<size_t> length;
+    ifstream hdrfile;
+    PMColumnsView view_at(int64_t offset, int64_t ns) const;
+    /* Not copyable - copies would unmap the files twice */
+    PMStore(const PMStore& parent);
+    PMStore& operator=(const PMStore& parent);
+};
+/*! \brief Appends PMTimeSeries objects to a PMStore.
+
+  Creates the store if it does not exist.  Otherwise new series are
+  appended to the existing ones.   The index record of a series is
+  written after its columns and header, so the index is always
+  consistent.   If a program writing a store dies, data it wrote past
+  the last complete index record are discarded the next time the
+  store is opened for writing.   Only one writer may have a store
+  open at a time.   If append throws because a write failed the
+  writer must not be used again.
+  */
+class PMStoreWriter
+{
+public:
+    /*! \brief Open a store for appending.
+
+      \param dir store directory.  Created if it does not exist.
+      \exception SeisppError is thrown if the directory can not be
+        created or an existing store is not valid.
+      */
+    PMStoreWriter(const string dir);
+    ~PMStoreWriter();
+    /*! \brief Append a series.
+
+      The series must have sta and evid defined in its Metadata.
+      Deferred error estimates are computed before writing.
+
+      \param d series to append
+      \param band band number used as part of the key
+      \exception SeisppError is thrown if sta or evid are missing, sta
+        is too long, or a write fails.
+      */
+    void append(PMTimeSeries& d, int band);
+    /*! Return number of series in the store. */
+    int number_series() const {return nseries;};
+private:
+    string directory;
+    int nseries;
+    int64_t nsamp;
+    int64_t hdrsize;
+    vector<ofstream *> colfiles;
+    ofstream hdrfile;
+    ofstream indexfile;
+    PMStoreWriter(const PMStoreWriter& parent);
+    PMStoreWriter& operator=(const PMStoreWriter& parent);
+};
+#endif
@@ -0,0 +1,201 @@
+#include <math.h>
+#include "PMPointEstimator.h"
+#include "PMTimeFrequencyGrid.h"
+using namespace std;
+using namespace SEISPP;
+PMTimeFrequencyGrid::PMTimeFrequencyGrid() : BasicTimeSeries(), Metadata()
+{
+    nbands=0;
+}
+/* Returns the band with the smallest sample interval */
+static int finest_band(MWTBundle& d)
+{
+    int bfine(0);
+    for(int b=1;b<d.number_bands();++b)
+        if(d.sample_interval(b)<d.sample_interval(bfine)) bfine=b;
+    return bfine;
+}
+PMTimeFrequencyGrid::PMTimeFrequencyGrid(MWTBundle& d, double dtgrid,
+        double confidence, int bsmultiplier, int avlen, long seed)
+    : BasicTimeSeries(), Metadata(dynamic_cast<Metadata&>(d))
+{
+    const string base_error("PMTimeFrequencyGrid constructor:  ");
+    try {
+        int bfine=finest_band(d);
+        MWTwaveform& x=d.waveform(bfine,0,0);
+        if(dtgrid>0.0)
+            dt=dtgrid;
+        else
+            dt=x.dt;
+        t0=x.t0;
+        tref=x.tref;
+        int nt(0);
+        if(x.ns>0) nt=((int)((x.dt*((double)(x.ns-1)))/dt))+1;
+        if(nt<=0) throw SeisppError(base_error
+                + "finest band has no data");
+        this->build(d,nt,confidence,bsmultiplier,avlen,seed);
+    }catch(...){throw;};
+}
+PMTimeFrequencyGrid::PMTimeFrequencyGrid(MWTBundle& d, TimeWindow tw,
+        double dtgrid, double confidence, int bsmultiplier, int avlen,
+        long seed)
+    : BasicTimeSeries(), Metadata(dynamic_cast<Metadata&>(d))
+{
+    const string base_error("PMTimeFrequencyGrid time window constructor:  ");
+    if(dtgrid<=0.0) throw SeisppError(base_error
+            + "grid sample interval must be positive");
+    if(tw.end<tw.start) throw SeisppError(base_error
+            + "time window end is before start");
+    try {
+        dt=dtgrid;
+        t0=tw.start;
+        tref=d.waveform(0,0,0).tref;
+        int nt=((int)((tw.end-tw.start)/dt))+1;
+        this->build(d,nt,confidence,bsmultiplier,avlen,seed);
+    }catch(...){throw;};
+}
+/* Does the work for both constructors.  t0, dt, and tref must be set.
+   Ellipses and bootstrap statistics for all bands and grid times are
+   computed in one parallel pass.  Each grid point has its own random
+   stream so the result does not depend on scheduling. */
+void PMTimeFrequencyGrid::build(MWTBundle& d, int nt, double confidence,
+        int bsmultiplier, int avlen, long seed)
+{
+    const string base_error("PMTimeFrequencyGrid::build:  ");
+    if(d.number_members() != 3)
+    {
+        stringstream ss;
+        ss << "Bundle size passed = "<<d.number_members()<<endl
+            << "This must be exactly 3 - likely coding error"<<endl;
+        throw SeisppError(base_error + ss.str());
+    }
+    live=false;
+    ns=nt;
+    nbands=d.number_bands();
+    int nw=d.number_wavelets();
+    int b,i,k;
+    vector<PMPointEstimator> estimators;
+    estimators.reserve(nbands);
+    f0.clear();
+    fw.clear();
+    for(b=0;b<nbands;++b)
+    {
+        estimators.push_back(PMPointEstimator(d,b,confidence,
+                    bsmultiplier,avlen));
+        f0.push_back(d.get_f0(b));
+        fw.push_back(d.get_fw(b));
+    }
+    uint64_t rng_seed;
+    if(seed>0)
+        rng_seed=(uint64_t)seed;
+    else
+        rng_seed=PMClockSeed();
+    uint32_t rng_source=PMRandomSourceKey(*this);
+    int ngrid=nbands*nt;
+    int ntrials=bsmultiplier*nw;
+    /* Results for grid point k (=b*nt+i) are stored here and copied
+       to grid at the end.  PMColumns can not be filled directly
+       because the estimated column is a vector<bool> whose elements
+       can not be written safely by different threads. */
+    vector<ParticleMotionEllipse> avgs(ngrid);
+    vector<ParticleMotionError> errs(ngrid);
+    bool failed(false);
+    const PMTimeSeriesControl defaults;
+#pragma omp parallel private(b,i,k)
+    {
+        /* Each thread reuses its own estimates and bootstrap space */
+        vector<ParticleMotionEllipse> work;
+        work.reserve(nw);
+        PMStatsWorkspace bswork;
+#pragma omp for schedule(dynamic,16)
+        for(k=0;k<ngrid;++k)
+        {
+            b=k/nt;
+            i=k-b*nt;
+            try {
+                /* Default constructed avgs and errs are the zero
+                   result used for invalid points */
+                if(estimators[b].wavelet_ellipses(t0+dt*((double)i),work))
+                {
+                    CounterRNG rng(rng_seed,(uint32_t)i,(uint32_t)b,
+                            rng_source);
+                    ComputePMStats(&(work[0]),work.size(),1,avgs[k],
+                            errs[k],confidence,ntrials,rng,defaults,bswork);
+                }
+            }catch(...)
+            {
+#pragma omp critical
+                failed=true;
+            }
+        }
+    }
+    if(failed) throw SeisppError(base_error
+            + "estimate failed for one or more grid points");
+    grid=PMColumns();
+    grid.reserve(ngrid);
+    for(k=0;k<ngrid;++k) grid.push_back(avgs[k],errs[k]);
+    this->put("bootstrap_seed",(long)rng_seed);
+    this->put("nsamp",ns);
+    this->put("samprate",1.0/dt);
+    this->put("nbands",nbands);
+    this->put("averaging_length",avlen);
+    live=true;
+}
+PMTimeFrequencyGrid::PMTimeFrequencyGrid(const PMTimeFrequencyGrid& parent)
+    : BasicTimeSeries(parent), Metadata(parent), f0(parent.f0),
+      fw(parent.fw), grid(parent.grid)
+{
+    nbands=parent.nbands;
+}
+PMTimeFrequencyGrid& PMTimeFrequencyGrid::operator=
+                    (const PMTimeFrequencyGrid& parent)
+{
+    if(this!=&parent)
+    {
+        this->BasicTimeSeries::operator=(parent);
+        this->Metadata::operator=(parent);
+        nbands=parent.nbands;
+        f0=parent.f0;
+        fw=parent.fw;
+        grid=parent.grid;
+    }
+    return(*this);
+}
+ParticleMotionEllipse PMTimeFrequencyGrid::ellipse(int b, int i) const
+{
+    if( (b<0) || (b>=nbands) || (i<0) || (i>=ns) )
+    {
+        stringstream ss;
+        ss << "PMTimeFrequencyGrid::ellipse method:  "
+            << "Requested band "<<b<<" and sample "<<i
+            << " are outside grid size "<<nbands<<" x "<<ns<<endl;
+        throw SeisppError(ss.str());
+    }
+    return(grid.get_ellipse(this->index(b,i)));
+}
+ParticleMotionError PMTimeFrequencyGrid::errors(int b, int i) const
+{
+    if( (b<0) || (b>=nbands) || (i<0) || (i>=ns) )
+    {
+        stringstream ss;
+        ss << "PMTimeFrequencyGrid::errors method:  "
+            << "Requested band "<<b<<" and sample "<<i
+            << " are outside grid size "<<nbands<<" x "<<ns<<endl;
+        throw SeisppError(ss.str());
+    }
+    return(grid.get_errors(this->index(b,i)));
+}
+dmatrix PMTimeFrequencyGrid::metric(PMMetric m) const
+{
+    dmatrix result(nbands,ns);
+    if((nbands<=0) || (ns<=0)) return result;
+    vector<PMMetric> which(1,m);
+    vector<double> work(ns);
+    double *out=&(work[0]);
+    for(int b=0;b<nbands;++b)
+    {
+        grid.fill_metrics(which,this->index(b,0),ns,&out);
+        for(int i=0;i<ns;++i) result(b,i)=work[i];
+    }
+    return result;
+}
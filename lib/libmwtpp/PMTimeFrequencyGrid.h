@@ -0,0 +1,106 @@
+#ifndef _PMTimeFrequencyGrid_h_
+#define _PMTimeFrequencyGrid_h_
+#include <vector>
+#include <boost/serialization/vector.hpp>
+#include <boost/archive/text_oarchive.hpp>
+#include <boost/archive/text_iarchive.hpp>
+#include "BasicTimeSeries.h"
+#include "Metadata.h"
+#include "dmatrix.h"
+#include "MWTransform.h"
+#include "PMTimeSeries.h"
+using namespace SEISPP;
+/*! \brief Particle motion estimates for all bands on a common time grid.
+
+  A PMTimeSeries holds estimates for one band sampled at that band's
+  (decimated) sample interval.   Time-frequency displays need all
+  bands at the same times.  This object holds ellipse and error
+  estimates for every band of a transform on one time grid.
+
+  The BasicTimeSeries attributes define the time grid.  ns is the
+  number of grid times.  Data are stored in one PMColumns object in
+  band by time order:  estimate for band b at grid time i is sample
+  b*ns+i.   Each band is thus a contiguous block of ns samples.
+
+  Estimates are computed with PMPointEstimator methods so bands sampled
+  more coarsely than the grid are interpolated.  Grid times where a
+  band has no valid estimate (e.g. beyond the ends of a coarse band)
+  are zeroed and have the estimated column set false.
+  */
+class PMTimeFrequencyGrid : public BasicTimeSeries, public Metadata
+{
+public:
+    /*! Default constructor.  Creates an empty grid. */
+    PMTimeFrequencyGrid();
+    /*! \brief Compute a grid spanning the data.
+
+      The grid spans the time range of the band with the smallest
+      sample interval.
+
+      \param d transformed data.  Must be a 3C bundle.
+      \param dtgrid grid sample interval.  If 0 or negative the
+        sample interval of the finest band is used.
+      \param confidence confidence level for the bootstrap errors
+      \param bsmultiplier number of bootstrap trials is this times
+        the number of wavelets.
+      \param avlen averaging length passed to PMPointEstimator
+        (1 or less means sample by sample).
+      \param seed seed for the bootstrap random streams.  The stream
+        for each grid point is keyed by band and grid index so results
+        for a given seed do not depend on the number of threads.
+        0 means derive a seed from the clock.   The seed used is
+        posted to metadata as bootstrap_seed.
+      */
+    PMTimeFrequencyGrid(MWTBundle& d, double dtgrid=0.0,
+            double confidence=0.95, int bsmultiplier=100, int avlen=1,
+            long seed=0);
+    /*! \brief Compute a grid in a specified time window.
+
+      Same as the other constructor but the grid starts at tw.start
+      and ends at the last grid time not after tw.end.  dtgrid must be
+      positive.
+      */
+    PMTimeFrequencyGrid(MWTBundle& d, TimeWindow tw, double dtgrid,
+            double confidence=0.95, int bsmultiplier=100, int avlen=1,
+            long seed=0);
+    PMTimeFrequencyGrid(const PMTimeFrequencyGrid& parent);
+    PMTimeFrequencyGrid& operator=(const PMTimeFrequencyGrid& parent);
+    int number_bands() const {return nbands;};
+    /*! Return center frequency of band b. */
+    double get_f0(int b) const {return f0.at(b);};
+    /*! Return bandwidth of band b. */
+    double get_fw(int b) const {return fw.at(b);};
+    /*! Return ellipse for band b at grid time i.
+      \exception SeisppError is thrown if b or i are out of range. */
+    ParticleMotionEllipse ellipse(int b, int i) const;
+    /*! Return error estimates for band b at grid time i.
+      \exception SeisppError is thrown if b or i are out of range. */
+    ParticleMotionError errors(int b, int i) const;
+    /*! Return the storage index for band b at grid time i.  No checking.*/
+    int index(int b, int i) const {return(b*ns+i);};
+    /*! Read only access to all the data.  See index for layout.*/
+    const PMColumns& columns() const {return grid;};
+    /*! \brief Return one scalar metric as a band by time matrix.
+
+      Row b of the result is band b.  Columns are grid times.
+      */
+    dmatrix metric(PMMetric m) const;
+private:
+    int nbands;
+    vector<double> f0,fw;
+    PMColumns grid;
+    void build(MWTBundle& d, int nt, double confidence,
+            int bsmultiplier, int avlen, long seed);
+    friend class boost::serialization::access;
+    template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+    {
+        ar & boost::serialization::base_object<Metadata>(*this);
+        ar & boost::serialization::base_object<BasicTimeSeries>(*this);
+        ar & nbands;
+        ar & f0;
+        ar & fw;
+        ar & grid;
+    };
+};
+#endif
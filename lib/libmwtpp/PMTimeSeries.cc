@@ -23,6 +23,17 @@ void PMTimeSeries::post_attributes_to_metadata()
    vector values converted to decibels. Throws an error if 
    a value is negative unless it is very tiny  - defines as 
    number less than FLT_EPSILON */
+static double amplitude_db(double x)
+{
+    if(x<=0.0)
+    {
+      if(fabs(x)<FLT_EPSILON)
+        return(20.0*log10(FLT_EPSILON));
+      else
+        throw SeisppError(string("dbamp procedure: negative values in put array are nonsense"));
+    }
+    return(20.0*log10(x));
+}
 vector<double> dbamp(vector<double>& x)
 {
   int nx=x.size();
@@ -30,60 +41,41 @@ vector<double> dbamp(vector<double>& x)
   result.reserve(nx);
   vector<double>::iterator xptr;
   for(xptr=x.begin();xptr!=x.end();++xptr)
-  {
-    double valdb;
-    if((*xptr)<=0.0)
-    {
-      if(fabs(*xptr)<FLT_EPSILON)
-        valdb=20.0*log10(FLT_EPSILON);
-      else
-        throw SeisppError(string("dbamp procedure: negative values in put array are nonsense"));
-    }
-    else
-    {
-      valdb=20.0*log10(*xptr);
-    }
-    result.push_back(valdb);
-  }
+    result.push_back(amplitude_db(*xptr));
   return result;
 }
 
 
-/*! Helper procedure.  Wrapper function for C libmultiwavelet
-  routine to estimate errors in particle motion ellipse parameters.
-  This procedure acts like a FORTRAN subroutine in that the average
-  particle motion and error estimates are returned as arguments.
-
-  This is a major revision from an earlier implemntation that
-  used a routine called pmvector_average in the old C multiwavelet
-  library.  Found that procedure produced errors that were too
-  large due to incorrect handling of multiple estimates of angles.
-  This version uses a new bootstrap error approach.
-
-arguments:
-  d - ensemble of ParticleMotionEllipse objects to be averaged
-  avg - average ParticleMotionEllipse
-  err - errors
-  */
-void ComputePMStats(vector<ParticleMotionEllipse>& d,
-        ParticleMotionEllipse& avg, ParticleMotionError& err,
-        double confidence_level, int number_of_trials)
+/* For minor we want to force the vector to be perpendicular to major
+axis vector.  We do this with a pair of vector cross products.  
+vmin is the average minor axis direction.  avg.major must already be set.*/
+static void orthogonal_minor(ParticleMotionEllipse& avg, double *vmin)
+{
+    double w[3],w2[3];
+    double nrmw;
+    dr3cros(avg.major,vmin,w);
+    nrmw=dnrm2(3,w,1);
+    dscal(3,1.0/nrmw,w,1);
+    dr3cros(w,avg.major,w2);
+    nrmw=dnrm2(3,w2,1);
+    dscal(3,1.0/nrmw,w2,1);
+    for(int j=0;j<3;++j) avg.minor[j]=w2[j];
+}
+/* Average of a set of ellipse estimates without error estimates.  
+   This is the quantity the bootstrap in ComputePMStats converges to 
+   as the number of trials grows:  amplitudes are averaged in dB and
+   axis directions are normalized vector means with the minor axis 
+   forced perpendicular to the major axis.   d is an nd vector of 
+   estimates with stride between them of stride. */
+static void PMAverage(const ParticleMotionEllipse *d, int nd, int stride,
+        ParticleMotionEllipse& avg)
 {
-  try{
-    /* This wrapper is a hideous inefficiency, but preferable to
-       rewriting pmvector_average which is quite complicated.  */
-    int nd=d.size();
     int i,j;
-    /* First test for null data and return null average and error
-     * if all the d values are zeros.  As always in floating point
-     * tests this has to make an assumption that the units of the 
-     * such that the data sample amplitudes are large compared to 
-     * epsilon*/
     bool zerotest(true);
     for(i=0;i<nd;++i)
     {
-        if((fabs(d[i].majornrm)>FLT_EPSILON) 
-                || (fabs(d[i].minornrm)>FLT_EPSILON) )
+        if((fabs(d[i*stride].majornrm)>FLT_EPSILON) 
+                || (fabs(d[i*stride].minornrm)>FLT_EPSILON) )
         {
             zerotest=false;
             break;
@@ -92,81 +84,110 @@ void ComputePMStats(vector<ParticleMotionEllipse>& d,
     if(zerotest)
     {
         avg=ParticleMotionEllipse();
-        err=ParticleMotionError();
         return;
     }
-    vector<double> major_amps, minor_amps,rect;
-    major_amps.reserve(nd);
-    minor_amps.reserve(nd);
-    rect.reserve(nd);
-    /* These two hold normalized major and minor axis vectors */
-    dmatrix dmajor(3,nd);
-    dmatrix dminor(3,nd);
+    /* Same floor as dbamp */
+    const double dbfloor(20.0*log10(FLT_EPSILON));
+    double majdb(0.0),mindb(0.0);
+    double vmaj[3]={0.0,0.0,0.0},vmin[3]={0.0,0.0,0.0};
     for(i=0;i<nd;++i)
     {
-      /* We assume the vectors passed are already normalized to be
-      unit vectors - amplitude is contained in the majornrm and minornrm
-      vectors */
+        const ParticleMotionEllipse& e=d[i*stride];
+        majdb += (e.majornrm>0.0 ? 20.0*log10(e.majornrm) : dbfloor);
+        mindb += (e.minornrm>0.0 ? 20.0*log10(e.minornrm) : dbfloor);
         for(j=0;j<3;++j)
         {
-            dmajor(j,i)=d[i].major[j];
-            dminor(j,i)=d[i].minor[j];
+            vmaj[j]+=e.major[j];
+            vmin[j]+=e.minor[j];
         }
-        major_amps.push_back(d[i].majornrm);
-        minor_amps.push_back(d[i].minornrm);
-        rect.push_back(d[i].rectilinearity());
     }
-    /* This is the old procedure that computed errors.  Replacing here
-    by bootstrap error estimation
-    Particle_Motion_Ellipse avgC;
-    Particle_Motion_Error errC;
-    pmvector_average(pmv,nd,&avgC,&errC); */
-    pair<double,double> majorampstats, minorampstats,rectstats;
-    vector<double> xdb=dbamp(major_amps);
-    majorampstats=bootstrap_mv(xdb,confidence_level,number_of_trials);
-    double nrmdb;
-    nrmdb=majorampstats.first;
-    /* We computed the average from log values - we need to get back to 
-     * original units. */
-    avg.majornrm=pow(10.0,nrmdb/20.0);
-    /* Note we leave error in db where it makes more sense */
-    err.dmajornrm=majorampstats.second;
-    xdb=dbamp(minor_amps);
-    minorampstats=bootstrap_mv(xdb,confidence_level,number_of_trials);
-    nrmdb=minorampstats.first;
-    avg.minornrm=pow(10.0,nrmdb/20.0);
-    err.dminornrm=minorampstats.second;
-    rectstats=bootstrap_mv(rect,confidence_level,number_of_trials);
+    avg.majornrm=pow(10.0,majdb/((double)nd)/20.0);
+    avg.minornrm=pow(10.0,mindb/((double)nd)/20.0);
+    double nrm=dnrm2(3,vmaj,1);
+    for(j=0;j<3;++j) avg.major[j]=vmaj[j]/nrm;
+    orthogonal_minor(avg,vmin);
+}
+/* Rounds an ellipse estimate to the single precision used by the 
+   deferred error store (see PMDeferredErrors).  The bootstrap sees 
+   only rounded estimates so errors computed from that store are 
+   identical to errors computed at construction. */
+static void pm_round(ParticleMotionEllipse& e)
+{
+    for(int j=0;j<3;++j)
+    {
+        e.major[j]=(double)((float)e.major[j]);
+        e.minor[j]=(double)((float)e.minor[j]);
+    }
+    e.majornrm=(double)((float)e.majornrm);
+    e.minornrm=(double)((float)e.minornrm);
+}
+/* Packs the nd estimates in d (estimate i is d[i*stride]) into the 
+   data layout used by MultiStatisticBootstrap.  scalars (3*nd values)
+   holds major dB, minor dB, and rectilinearity.  vectors (6*nd values)
+   holds the major and minor axis unit vectors.  Estimates are rounded
+   with pm_round first.  Returns false and leaves the output untouched
+   if all the d values are zero. */
+static bool pm_pack(const ParticleMotionEllipse *d, int nd, int stride,
+        double *scalars, double *vectors)
+{
+    int i,j;
+    /* Test for null data.  As always in floating point tests this has 
+     * to make an assumption that the units of the such that the data 
+     * sample amplitudes are large compared to epsilon*/
+    bool zerotest(true);
+    for(i=0;i<nd;++i)
+    {
+        if((fabs((float)d[i*stride].majornrm)>FLT_EPSILON) 
+                || (fabs((float)d[i*stride].minornrm)>FLT_EPSILON) )
+        {
+            zerotest=false;
+            break;
+        }
+    }
+    if(zerotest) return false;
+    /* All five statistics are computed from one set of resamples.
+       scalars holds major dB, minor dB, and rectilinearity.  vectors
+       holds the major and minor axis unit vectors (see 
+       MultiStatisticBootstrap for the layout). We assume the vectors 
+       passed are already normalized to be unit vectors - amplitude is
+       contained in the majornrm and minornrm attributes */
+    for(i=0;i<nd;++i)
+    {
+        /* rectilinearity is not a const method */
+        ParticleMotionEllipse e(d[i*stride]);
+        pm_round(e);
+        for(j=0;j<3;++j)
+        {
+            vectors[j*nd+i]=e.major[j];
+            vectors[(3+j)*nd+i]=e.minor[j];
+        }
+        scalars[i]=amplitude_db(e.majornrm);
+        scalars[nd+i]=amplitude_db(e.minornrm);
+        scalars[2*nd+i]=e.rectilinearity();
+    }
+    return true;
+}
+/* Converts bootstrap results for data packed by pm_pack to error
+   estimates.  avg is the average ellipse of the same data (see 
+   PMAverage).   Its axes set the scaling of the azimuth errors. */
+static void pm_unpack(const MultiStatisticBootstrap& bs, int nd,
+        const ParticleMotionEllipse& avg, ParticleMotionError& err)
+{
+    /* Note we leave amplitude errors in db where they make more sense */
+    err.dmajornrm=bs.halfrange(0);
+    err.dminornrm=bs.halfrange(1);
     /*rectilinearity is derived from length of min and max axes as a method of
      * ParticleMotionEllipse.  We thus save only the error estimate here */
-    err.delta_rect=rectstats.second;
-    Vector3DBootstrapError majboot(dmajor,confidence_level,number_of_trials);
-    Vector3DBootstrapError minboot(dminor,confidence_level,number_of_trials);
-    /* For major we just copy the bootstrap mean */
-    vector<double> vmed;
-    vmed=majboot.mean_vector();
-    for(j=0;j<3;++j) avg.major[j] = vmed[j];  // assumes vmed is unit vector
-    /* For minor we want to force the vector to be perpendicular to major
-    axis vector.  We do this with a pair of vector cross products. */
-    vmed=minboot.mean_vector();
-    double w[3],w2[3];
-    double nrmw;
-    dr3cros(avg.major,&(vmed[0]),w);
-    nrmw=dnrm2(3,w,1);
-    dscal(3,1.0/nrmw,w,1);
-    dr3cros(w,avg.major,w2);
-    nrmw=dnrm2(3,w2,1);
-    dscal(3,1.0/nrmw,w2,1);
-    for(j=0;j<3;++j) avg.minor[j]=w2[j];
+    err.delta_rect=bs.halfrange(2);
     /* For this implementation we use the bootstrap error in the dot
     product angle between resampled observations as estimate for the
     error all angle terms.  This has to be scaled by 1/sin(theta) for
     azimuth for inclination the angle error is used directly.
     Note all errors estimates are retained as radians. */
-    double aerr=majboot.angle_error();
+    double aerr=bs.angle_error(0);
     double vert[3]={0.0,0.0,1.0}; //vertical direction with our convention
     double theta,vproj;
-    vproj=ddot(3,avg.major,1,vert,1);
+    vproj=ddot(3,const_cast<double *>(avg.major),1,vert,1);
     theta=acos(vproj);
     /* This will be botched if theta is negative, which it will be if
      * the vector has a downward component.  Hence this correction */
@@ -188,8 +209,8 @@ void ComputePMStats(vector<ParticleMotionEllipse>& d,
     err.dtheta_major=aerr;
     if(err.dtheta_major>M_PI) err.dtheta_major=M_PI;  //probably not necessary but useful
     /* Similar for minor axis except we reuse the variables */
-    aerr=minboot.angle_error();
-    vproj=ddot(3,avg.minor,1,vert,1);
+    aerr=bs.angle_error(1);
+    vproj=ddot(3,const_cast<double *>(avg.minor),1,vert,1);
     theta=acos(vproj);
     if(theta<0.0) theta=(-theta);
     if(theta>thetafloor)
@@ -213,8 +234,627 @@ void ComputePMStats(vector<ParticleMotionEllipse>& d,
     err.ndgf_rect=nd-1;
     err.ndgf_major_amp=nd-1;
     err.ndgf_minor_amp=nd-1;
+    err.ntrials=bs.trials_used();
+    err.estimated=true;
+}
+/*! Helper procedure.  Wrapper function for C libmultiwavelet
+  routine to estimate errors in particle motion ellipse parameters.
+  This procedure acts like a FORTRAN subroutine in that the average
+  particle motion and error estimates are returned as arguments.
+
+  This is a major revision from an earlier implemntation that
+  used a routine called pmvector_average in the old C multiwavelet
+  library.  Found that procedure produced errors that were too
+  large due to incorrect handling of multiple estimates of angles.
+  This version uses a new bootstrap error approach.
+
+arguments:
+  d - ensemble of ParticleMotionEllipse objects to be averaged
+  avg - average of d computed by PMAverage (input)
+  err - errors
+  */
+static void pm_errors(const ParticleMotionEllipse *d, int nd, int stride,
+        const ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials, CounterRNG *rng,
+        const PMTimeSeriesControl& control, PMStatsWorkspace& work)
+{
+  try{
+    /* All five statistics are computed from one set of resamples.
+       See pm_pack for the data layout.  resize does nothing when 
+       work is reused for data of the same size. */
+    work.scalars.resize(3*nd);
+    work.vectors.resize(6*nd);
+    double *scalars=&(work.scalars[0]);
+    double *vectors=&(work.vectors[0]);
+    if(!pm_pack(d,nd,stride,scalars,vectors))
+    {
+        err=ParticleMotionError();
+        return;
+    }
+    /* This is the old procedure that computed errors.  Replacing here
+    by bootstrap error estimation
+    Particle_Motion_Ellipse avgC;
+    Particle_Motion_Error errC;
+    pmvector_average(pmv,nd,&avgC,&errC); */
+    MultiStatisticBootstrap& bs=work.bootstrap;
+    /* rng is NULL for the original clock seeded generator.  The 
+       adaptive bootstrap is only used with a CounterRNG stream. */
+    if(control.error_estimator==PMJackknifeErrors)
+        bs.run_jackknife(nd,3,scalars,2,vectors,confidence_level);
+    else if(rng==NULL)
+        bs.run(nd,3,scalars,2,vectors,confidence_level,
+            number_of_trials);
+    else if(control.adaptive_bootstrap)
+        bs.run_adaptive(nd,3,scalars,2,vectors,
+            confidence_level,control.bootstrap_batch_size,
+            number_of_trials,control.bootstrap_tolerance,*rng);
+    else
+        bs.run(nd,3,scalars,2,vectors,confidence_level,
+            number_of_trials,*rng);
+    pm_unpack(bs,nd,avg,err);
+  }catch(...){throw;};
+}
+/* The average is the direct average of d.  It does not depend on the 
+   bootstrap so it is the same for every error option and for 
+   deferred errors. */
+static void pm_stats(const ParticleMotionEllipse *d, int nd, int stride,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials, CounterRNG *rng,
+        const PMTimeSeriesControl& control, PMStatsWorkspace& work)
+{
+    PMAverage(d,nd,stride,avg);
+    pm_errors(d,nd,stride,avg,err,confidence_level,number_of_trials,
+            rng,control,work);
+}
+void ComputePMStats(vector<ParticleMotionEllipse>& d,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials)
+{
+    PMStatsWorkspace work;
+    pm_stats(&(d[0]),d.size(),1,avg,err,confidence_level,number_of_trials,
+            NULL,PMTimeSeriesControl(),work);
+}
+void ComputePMStats(vector<ParticleMotionEllipse>& d,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials, CounterRNG& rng)
+{
+    PMStatsWorkspace work;
+    pm_stats(&(d[0]),d.size(),1,avg,err,confidence_level,number_of_trials,
+            &rng,PMTimeSeriesControl(),work);
+}
+void ComputePMStats(vector<ParticleMotionEllipse>& d,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials, CounterRNG& rng,
+        const PMTimeSeriesControl& control)
+{
+    PMStatsWorkspace work;
+    pm_stats(&(d[0]),d.size(),1,avg,err,confidence_level,number_of_trials,
+            &rng,control,work);
+}
+void ComputePMStats(const ParticleMotionEllipse *d, int nd, int stride,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials, CounterRNG& rng,
+        const PMTimeSeriesControl& control, PMStatsWorkspace& work)
+{
+    pm_stats(d,nd,stride,avg,err,confidence_level,number_of_trials,
+            &rng,control,work);
+}
+/* Error estimates for a block of samples with a shared resample plan.
+   avg holds the average ellipse of each sample (input).  See 
+   ComputePMStatsPlanned for the other arguments. */
+static void pm_planned_errors(vector<ParticleMotionEllipse>& d, int nw,
+        const vector<ParticleMotionEllipse>& avg, 
+        vector<ParticleMotionError>& err,
+        double confidence_level, MultiStatisticBootstrap& plan)
+{
+  try{
+    int nsamp=d.size()/nw;
+    int s;
+    err.resize(nsamp);
+    if(nsamp<=0) return;
+    vector<double> scalars(3*nw*nsamp,0.0),vectors(6*nw*nsamp,0.0);
+    /* Samples with all zero data are left as zeros in the block and 
+       get the null result */
+    vector<bool> nonzero(nsamp);
+    for(s=0;s<nsamp;++s)
+        nonzero[s]=pm_pack(&(d[s*nw]),nw,1,&(scalars[3*nw*s]),
+                &(vectors[6*nw*s]));
+    plan.run_planned(nw,nsamp,3,&(scalars[0]),2,&(vectors[0]),
+            confidence_level);
+    for(s=0;s<nsamp;++s)
+    {
+        if(nonzero[s])
+        {
+            plan.select(s);
+            pm_unpack(plan,nw,avg[s],err[s]);
+        }
+        else
+            err[s]=ParticleMotionError();
+    }
   }catch(...){throw;};
 }
+void ComputePMStatsPlanned(vector<ParticleMotionEllipse>& d, int nw,
+        vector<ParticleMotionEllipse>& avg, vector<ParticleMotionError>& err,
+        double confidence_level, MultiStatisticBootstrap& plan)
+{
+    int nsamp=d.size()/nw;
+    avg.resize(nsamp);
+    for(int s=0;s<nsamp;++s) PMAverage(&(d[s*nw]),nw,1,avg[s]);
+    pm_planned_errors(d,nw,avg,err,confidence_level,plan);
+}
+PMTimeSeriesControl::PMTimeSeriesControl()
+{
+    incremental_covariance=false;
+    output_stride=1;
+    bootstrap_gate_threshold=0.0;
+    bootstrap_gate_noise_multiple=0.0;
+    bootstrap_gate_noise_start=0.0;
+    bootstrap_gate_noise_end=0.0;
+    lazy_errors=false;
+    trim_wavelet_edges=false;
+    bootstrap_seed=0;
+    adaptive_bootstrap=false;
+    bootstrap_batch_size=100;
+    bootstrap_tolerance=0.05;
+    error_estimator=PMBootstrapErrors;
+    bootstrap_plan_block=0;
+}
+PMTimeSeriesControl::PMTimeSeriesControl(Metadata& md)
+{
+    /* Start with defaults and override anything defined in md */
+    *this=PMTimeSeriesControl();
+    if(md.is_attribute("incremental_covariance"))
+        incremental_covariance=md.get_bool("incremental_covariance");
+    if(md.is_attribute("output_stride"))
+        output_stride=md.get_int("output_stride");
+    if(md.is_attribute("bootstrap_gate_threshold"))
+        bootstrap_gate_threshold=md.get_double("bootstrap_gate_threshold");
+    if(md.is_attribute("bootstrap_gate_noise_multiple"))
+        bootstrap_gate_noise_multiple
+            =md.get_double("bootstrap_gate_noise_multiple");
+    if(md.is_attribute("bootstrap_gate_noise_start"))
+        bootstrap_gate_noise_start
+            =md.get_double("bootstrap_gate_noise_start");
+    if(md.is_attribute("bootstrap_gate_noise_end"))
+        bootstrap_gate_noise_end=md.get_double("bootstrap_gate_noise_end");
+    if(md.is_attribute("lazy_errors"))
+        lazy_errors=md.get_bool("lazy_errors");
+    if(md.is_attribute("trim_wavelet_edges"))
+        trim_wavelet_edges=md.get_bool("trim_wavelet_edges");
+    if(md.is_attribute("bootstrap_seed"))
+        bootstrap_seed=md.get_long("bootstrap_seed");
+    if(md.is_attribute("adaptive_bootstrap"))
+        adaptive_bootstrap=md.get_bool("adaptive_bootstrap");
+    if(md.is_attribute("bootstrap_batch_size"))
+        bootstrap_batch_size=md.get_int("bootstrap_batch_size");
+    if(md.is_attribute("bootstrap_tolerance"))
+        bootstrap_tolerance=md.get_double("bootstrap_tolerance");
+    if(md.is_attribute("bootstrap_plan_block"))
+        bootstrap_plan_block=md.get_int("bootstrap_plan_block");
+    if(md.is_attribute("error_estimator"))
+    {
+        string name=md.get_string("error_estimator");
+        if(name==PMErrorEstimatorName(PMBootstrapErrors))
+            error_estimator=PMBootstrapErrors;
+        else if(name==PMErrorEstimatorName(PMJackknifeErrors))
+            error_estimator=PMJackknifeErrors;
+        else
+            throw SeisppError(string("PMTimeSeriesControl constructor:  ")
+                + "unknown error_estimator="+name
+                + "\nMust be bootstrap or jackknife");
+    }
+}
+string PMErrorEstimatorName(PMErrorEstimator e)
+{
+    if(e==PMJackknifeErrors)
+        return string("jackknife");
+    else
+        return string("bootstrap");
+}
+/* Sets the coordinates of the bootstrap random streams.  Must be 
+   called after metadata are copied to this and before 
+   compute_statistics. */
+void PMTimeSeries::set_random_streams(int band, 
+        const PMTimeSeriesControl& control)
+{
+    if(control.bootstrap_seed>0)
+        rng_seed=(uint64_t)control.bootstrap_seed;
+    else
+        rng_seed=PMClockSeed();
+    rng_band=(uint32_t)band;
+    rng_source=PMRandomSourceKey(*this);
+    this->put("bootstrap_seed",(long)rng_seed);
+}
+/* Used by both constructors to trim the component waveforms of a 
+   band to the interior not affected by edge effects.  Does nothing
+   to data already trimmed (usually by MWTransform).*/
+static void trim_band_edges(vector<MWTwaveform>& x, vector<MWTwaveform>& y,
+        vector<MWTwaveform>& z)
+{
+    for(int iw=0;iw<x.size();++iw)
+    {
+        x[iw].trim_edges();
+        y[iw].trim_edges();
+        z[iw].trim_edges();
+    }
+}
+/* Posts the edge trimming attributes if x, a waveform of the band, 
+   was trimmed here or by MWTransform.   Must be called after dt is 
+   set as the savings are reported in output samples.*/
+void PMTimeSeries::post_edge_trim(MWTwaveform& x)
+{
+    if(!x.is_attribute("edge_trimmed")) return;
+    int nh=x.get_int("edge_trim_samples");
+    long nsaved=SEISPP::nint(2.0*((double)nh)*x.dt/(this->dt));
+    this->put("edge_trimmed",true);
+    this->put("edge_trim_length",wavelet_duration/2.0);
+    this->put("valid_starttime",x.t0);
+    this->put("valid_endtime",x.t0+x.dt*((double)(x.ns-1)));
+    this->put("edge_trim_estimates_saved",nsaved);
+}
+/* Private method shared by the constructors.  pmw holds nw ellipse 
+   estimates (one per wavelet) for each of nsamp output samples.  
+   Estimate iw for sample i is pmw[i*sstride+iw*wstride].   This 
+   computes the average and error estimates for each sample and 
+   appends them to pmcols.  t0 and dt must be set before calling
+   as they are needed to locate the noise window for gating. */
+void PMTimeSeries::compute_statistics(vector<ParticleMotionEllipse>& pmw,
+        int nsamp, int nw, int sstride, int wstride, double confidence, 
+        int ntrials, const PMTimeSeriesControl& control)
+{
+    const string base_error("PMTimeSeries::compute_statistics:  ");
+    int i,iw;
+    ParticleMotionEllipse avg;
+    ParticleMotionError err;
+    /* Reused for every sample so the bootstrap allocates nothing after
+       the first sample */
+    PMStatsWorkspace work;
+    pmcols.reserve(pmcols.size()+nsamp);
+    bool gating=((control.bootstrap_gate_threshold>0.0)
+            || (control.bootstrap_gate_noise_multiple>0.0));
+    /* Sample number of the first sample.  Used as a random stream 
+       coordinate. */
+    int ibase=pmcols.size();
+    this->put("lazy_errors",control.lazy_errors);
+    this->put("error_estimator",
+            PMErrorEstimatorName(control.error_estimator));
+    this->put("adaptive_bootstrap",control.adaptive_bootstrap);
+    if(control.adaptive_bootstrap)
+    {
+        this->put("bootstrap_batch_size",control.bootstrap_batch_size);
+        this->put("bootstrap_tolerance",control.bootstrap_tolerance);
+    }
+    this->put("bootstrap_plan_block",control.bootstrap_plan_block);
+    bool planned=((control.bootstrap_plan_block!=0)
+            && (control.error_estimator==PMBootstrapErrors));
+    /* Wavelet estimates and sample numbers of samples to be computed 
+       with shared resample plans */
+    vector<ParticleMotionEllipse> pmplanned;
+    vector<int> iplanned;
+    if(!gating && !control.lazy_errors)
+    {
+        if(planned)
+        {
+            pmplanned.reserve(nsamp*nw);
+            iplanned.reserve(nsamp);
+            for(i=0;i<nsamp;++i)
+            {
+                for(iw=0;iw<nw;++iw) 
+                    pmplanned.push_back(pmw[i*sstride+iw*wstride]);
+                iplanned.push_back(ibase+i);
+                /* planned_statistics only sets the errors */
+                PMAverage(&(pmw[i*sstride]),nw,wstride,avg);
+                pmcols.push_back(avg,ParticleMotionError());
+            }
+            this->planned_statistics(pmplanned,iplanned,nw,confidence,
+                    ntrials,control.bootstrap_plan_block);
+            return;
+        }
+        for(i=0;i<nsamp;++i)
+        {
+            CounterRNG rng(rng_seed,(uint32_t)(ibase+i),rng_band,rng_source);
+            ComputePMStats(&(pmw[i*sstride]),nw,wstride,avg,err,confidence,
+                    ntrials,rng,control,work);
+            pmcols.push_back(avg,err);
+        }
+        return;
+    }
+    /* With gating or deferred errors we need the averages of all 
+       samples first.   They are cheap compared to the bootstrap.*/
+    vector<ParticleMotionEllipse> avgs(nsamp);
+    for(i=0;i<nsamp;++i)
+        PMAverage(&(pmw[i*sstride]),nw,wstride,avgs[i]);
+    double threshold=control.bootstrap_gate_threshold;
+    if(gating && (control.bootstrap_gate_noise_multiple>0.0))
+    {
+        double sumsq(0.0),t;
+        int nnoise(0);
+        for(i=0;i<nsamp;++i)
+        {
+            t=(this->t0)+((double)i)*(this->dt);
+            if( (t>=control.bootstrap_gate_noise_start) 
+                    && (t<=control.bootstrap_gate_noise_end) )
+            {
+                sumsq+=avgs[i].majornrm*avgs[i].majornrm;
+                ++nnoise;
+            }
+        }
+        if(nnoise<=0)
+        {
+            stringstream ss;
+            ss << "Noise window for bootstrap gating ("
+                << control.bootstrap_gate_noise_start<<","
+                << control.bootstrap_gate_noise_end<<") "
+                << "contains no samples of this time series"<<endl;
+            throw SeisppError(base_error+ss.str());
+        }
+        double noiserms=sqrt(sumsq/((double)nnoise));
+        double noisegate=control.bootstrap_gate_noise_multiple*noiserms;
+        if(noisegate>threshold) threshold=noisegate;
+        this->put("bootstrap_gate_noise_rms",noiserms);
+    }
+    int ngated(0);
+    if(control.lazy_errors)
+    {
+        if((deferred.nw>0) && (deferred.nw!=nw))
+            throw SeisppError(base_error 
+                + "number of wavelets changed for deferred error data");
+        deferred.nw=nw;
+        deferred.confidence=confidence;
+        deferred.ntrials=ntrials;
+        deferred.control=control;
+        deferred.resize(nw*(ibase+nsamp));
+        deferred.pending.resize(ibase+nsamp,false);
+    }
+    for(i=0;i<nsamp;++i)
+    {
+        if(gating && (avgs[i].majornrm<threshold))
+        {
+            /* Default constructor zeros err and sets estimated false */
+            pmcols.push_back(avgs[i],ParticleMotionError());
+            ++ngated;
+        }
+        else if(control.lazy_errors)
+        {
+            /* Store the wavelet estimates and defer the bootstrap.
+               The ellipse is final.  Only the errors are deferred. */
+            for(iw=0;iw<nw;++iw)
+                deferred.set(nw*(ibase+i)+iw,pmw[i*sstride+iw*wstride]);
+            pmcols.push_back(avgs[i],ParticleMotionError());
+            deferred.pending[ibase+i]=true;
+            ++deferred.npending;
+        }
+        else if(planned)
+        {
+            for(iw=0;iw<nw;++iw) 
+                pmplanned.push_back(pmw[i*sstride+iw*wstride]);
+            iplanned.push_back(ibase+i);
+            /* Errors are set by planned_statistics below */
+            pmcols.push_back(avgs[i],ParticleMotionError());
+        }
+        else
+        {
+            CounterRNG rng(rng_seed,(uint32_t)(ibase+i),rng_band,rng_source);
+            ComputePMStats(&(pmw[i*sstride]),nw,wstride,avg,err,confidence,
+                    ntrials,rng,control,work);
+            pmcols.push_back(avg,err);
+        }
+    }
+    if(iplanned.size()>0)
+        this->planned_statistics(pmplanned,iplanned,nw,confidence,
+                ntrials,control.bootstrap_plan_block);
+    if(gating)
+    {
+        this->put("bootstrap_gate_threshold",threshold);
+        this->put("bootstrap_gated_samples",ngated);
+    }
+}
+void PMTimeSeries::append(const PMColumns& d, double tstart, double horizon)
+{
+    const string base_error("PMTimeSeries::append:  ");
+    if(dt<=0.0) throw SeisppError(base_error
+            + "sample interval is not set");
+    if(d.size()<=0) return;
+    if(ns<=0)
+    {
+        t0=tstart;
+    }
+    else
+    {
+        double tnext=t0+dt*((double)ns);
+        if(fabs(tstart-tnext)>(0.5*dt))
+        {
+            stringstream ss;
+            ss << "Data to append are not continuous"<<endl
+                << "Time of next sample="<<tnext
+                << " but data to append start at "<<tstart<<endl;
+            throw SeisppError(base_error+ss.str());
+        }
+    }
+    pmcols.append(d);
+    ns=pmcols.size();
+    if(horizon>0.0)
+    {
+        int nkeep=((int)(horizon/dt))+1;
+        int nstale=ns-nkeep;
+        /* Only drop when the stale samples are as many as those kept 
+           so each sample is moved at most a fixed number of times */
+        if((nstale>0) && (nstale>=nkeep))
+        {
+            pmcols.erase_front(nstale);
+            if(deferred.pending.size()>0)
+            {
+                int nd=nstale;
+                if(nd>deferred.pending.size()) nd=deferred.pending.size();
+                for(int i=0;i<nd;++i)
+                    if(deferred.pending[i]) --deferred.npending;
+                deferred.pending.erase(deferred.pending.begin(),
+                        deferred.pending.begin()+nd);
+                deferred.erase_front(deferred.nw*nd);
+                /* Keeps the random streams of the remaining samples */
+                deferred.first+=nd;
+                if(deferred.npending<=0) deferred=PMDeferredErrors();
+            }
+            t0+=dt*((double)nstale);
+            ns=pmcols.size();
+        }
+    }
+    this->put("nsamp",ns);
+    live=true;
+}
+void PMTimeSeries::append(PMTimeSeries& d, double horizon)
+{
+    const string base_error("PMTimeSeries::append:  ");
+    if(ns<=0)
+    {
+        /* Metadata carry the identity of the series (sta, evid, band) */
+        this->Metadata::operator=(dynamic_cast<Metadata&>(d));
+        dt=d.dt;
+        tref=d.tref;
+        averaging_length=d.averaging_length;
+        f0=d.f0;
+        fw=d.fw;
+        decfac=d.decfac;
+        wavelet_duration=d.wavelet_duration;
+        this->post_attributes_to_metadata();
+    }
+    else if(fabs(d.dt-dt)>(0.001*dt))
+    {
+        stringstream ss;
+        ss << "Sample interval mismatch"<<endl
+            << "This object has dt="<<dt
+            << " data to append have dt="<<d.dt<<endl;
+        throw SeisppError(base_error+ss.str());
+    }
+    else if((fabs(d.f0-f0)>(0.001*fabs(f0))) 
+            || (fabs(d.fw-fw)>(0.001*fabs(fw)))
+            || (d.decfac!=decfac) 
+            || (d.averaging_length!=averaging_length))
+    {
+        stringstream ss;
+        ss << "Band or averaging length mismatch"<<endl
+            << "This object has f0="<<f0<<" fw="<<fw
+            << " decfac="<<decfac
+            << " averaging_length="<<averaging_length<<endl
+            << "Data to append have f0="<<d.f0<<" fw="<<d.fw
+            << " decfac="<<d.decfac
+            << " averaging_length="<<d.averaging_length<<endl;
+        throw SeisppError(base_error+ss.str());
+    }
+    d.evaluate_errors();
+    try {
+        this->append(d.pmcols,d.t0,horizon);
+    }catch(...){throw;};
+}
+void PMTimeSeries::evaluate_errors(int i0, int i1)
+{
+    if(deferred.npending<=0) return;
+    if(i0<0) i0=0;
+    if(i1>deferred.pending.size()) i1=deferred.pending.size();
+    int nw=deferred.nw;
+    ParticleMotionEllipse avg;
+    ParticleMotionError err;
+    int i,k;
+    vector<ParticleMotionEllipse> pmi(nw);
+    bool planned=((deferred.control.bootstrap_plan_block!=0)
+            && (deferred.control.error_estimator==PMBootstrapErrors));
+    vector<ParticleMotionEllipse> pmplanned;
+    vector<int> iplanned;
+    for(i=i0;i<i1;++i)
+    {
+        if(!deferred.pending[i]) continue;
+        for(k=0;k<nw;++k) pmi[k]=deferred.get(nw*i+k);
+        if(planned)
+        {
+            pmplanned.insert(pmplanned.end(),pmi.begin(),pmi.end());
+            iplanned.push_back(i);
+            continue;
+        }
+        CounterRNG rng(rng_seed,(uint32_t)(deferred.first+i),rng_band,
+                rng_source);
+        /* The stored ellipse is the average of the full precision
+           estimates so the errors are those computed at construction */
+        avg=pmcols.get_ellipse(i);
+        pm_errors(&(pmi[0]),nw,1,avg,err,deferred.confidence,
+                deferred.ntrials,&rng,deferred.control,deferred.work);
+        pmcols.set_errors(i,err);
+        deferred.pending[i]=false;
+        --deferred.npending;
+    }
+    if(iplanned.size()>0)
+    {
+        this->planned_statistics(pmplanned,iplanned,nw,deferred.confidence,
+                deferred.ntrials,deferred.control.bootstrap_plan_block,
+                deferred.first);
+        for(k=0;k<iplanned.size();++k)
+        {
+            deferred.pending[iplanned[k]]=false;
+            --deferred.npending;
+        }
+    }
+    /* Release the wavelet estimates once everything is computed*/
+    if(deferred.npending<=0) deferred=PMDeferredErrors();
+}
+/* Resample plans are drawn from streams with this bit set in the 
+   sample coordinate so a plan never uses the stream of a sample */
+const uint32_t PMPlanStreamFlag(0x80000000u);
+/* Maximum number of samples passed to one run_planned call.  Bounds the
+   size of the array of trial means. */
+const int PMPlanChunk(32);
+/* Computes bootstrap statistics with shared resample plans.  isamp 
+   lists (in increasing order) the sample numbers to be computed and
+   pmw holds the nw wavelet estimates for each of them contiguously.  
+   Samples are grouped in blocks of blocksize sample numbers (the whole
+   series if blocksize is negative) and one plan is drawn per block.
+   isamp are indices into pmcols.  ifirst is added to them to get the
+   sample numbers that define the blocks (see PMDeferredErrors::first).
+   The average ellipses must already be in pmcols.  Only the errors 
+   are set. */
+void PMTimeSeries::planned_statistics(vector<ParticleMotionEllipse>& pmw,
+        const vector<int>& isamp, int nw, double confidence, int ntrials,
+        int blocksize, int ifirst)
+{
+    int n=isamp.size();
+    MultiStatisticBootstrap plan;
+    vector<ParticleMotionEllipse> d,avg;
+    vector<ParticleMotionError> err;
+    int j0,j1,jc,je,j;
+    try {
+        for(j0=0;j0<n;j0=j1)
+        {
+            int block=(blocksize>0 ? (ifirst+isamp[j0])/blocksize : 0);
+            for(j1=j0+1;j1<n;++j1)
+                if((blocksize>0) && (((ifirst+isamp[j1])/blocksize)!=block)) 
+                    break;
+            CounterRNG rng(rng_seed,PMPlanStreamFlag|((uint32_t)block),
+                    rng_band,rng_source);
+            plan.plan(nw,ntrials,rng);
+            for(jc=j0;jc<j1;jc=je)
+            {
+                je=jc+PMPlanChunk;
+                if(je>j1) je=j1;
+                d.assign(pmw.begin()+jc*nw,pmw.begin()+je*nw);
+                avg.resize(je-jc);
+                for(j=jc;j<je;++j) avg[j-jc]=pmcols.get_ellipse(isamp[j]);
+                pm_planned_errors(d,nw,avg,err,confidence,plan);
+                for(j=jc;j<je;++j) pmcols.set_errors(isamp[j],err[j-jc]);
+            }
+        }
+    }catch(...){throw;};
+}
+int PMAutomaticStride(double fw, double wavelet_duration, double dt)
+{
+    if(dt<=0.0) return(1);
+    double dtmax=wavelet_duration/2.0;
+    if(fw>0.0)
+    {
+        double dtband=1.0/(2.0*fw);
+        if(dtband<dtmax) dtmax=dtband;
+    }
+    int stride=(int)floor(dtmax/dt);
+    if(stride<1) stride=1;
+    return(stride);
+}
 PMTimeSeries::PMTimeSeries() : Metadata(), BasicTimeSeries()
 {
     averaging_length=0;
@@ -222,10 +862,13 @@ PMTimeSeries::PMTimeSeries() : Metadata(), BasicTimeSeries()
     fw=0.0;
     decfac=0;
     wavelet_duration=0.0;
+    rng_seed=0;
+    rng_band=0;
+    rng_source=0;
 }
 
 PMTimeSeries::PMTimeSeries(MWTBundle& d, int band, int timesteps, int avlen,
-    double confidence, int bsmultiplier)
+    double confidence, int bsmultiplier, const PMTimeSeriesControl& control)
     : Metadata(dynamic_cast<Metadata&>(d))
 {
     const string base_error("PMTimeSeries time averaging constructor:  ");
@@ -271,6 +914,7 @@ PMTimeSeries::PMTimeSeries(MWTBundle& d, int band, int timesteps, int avlen,
             y.push_back(d(band,iw,1));
             z.push_back(d(band,iw,2));
         }
+        if(control.trim_wavelet_edges) trim_band_edges(x,y,z);
         /* These are required attributes from BasicTimeSeries.  We have
            to assume we can estract them from the components we just
            built. */
@@ -316,13 +960,22 @@ PMTimeSeries::PMTimeSeries(MWTBundle& d, int band, int timesteps, int avlen,
                 << "This less than requested averaging length of "<<avlen<<endl;
             throw SeisppError(base_error + ss.str());
         }
-        vector<ParticleMotionEllipse> pmi;   // nw estimates for each i
-        ParticleMotionEllipse avg;
-        ParticleMotionError err;
-        pmi.reserve(nw);
+        /* Ellipse estimates for all wavelets and all output samples.
+           Estimates for sample i are in pmw[i*nw] to pmw[i*nw+nw-1]. */
+        vector<ParticleMotionEllipse> pmw;
+        pmw.reserve(nw*((this->ns)/timesteps+1));
+        int nsout(0);
         //assume x,y, and z have common start times 
         this->t0=x[0].t0+time_avlen/2.0;  //use centered time as reference
         double t;  // this is start time of averaging window not center
+        /* These are used only for the incremental covariance method.  
+           ntw is the window length in samples computed the same way 
+           as WindowView.   jslast is the first sample of the previous 
+           window and nadded counts samples added since the sums were
+           last rebuilt from scratch. */
+        vector<PMCovariance> cov(nw);
+        int ntw=SEISPP::nint(time_avlen/x[0].dt)+1;
+        int js,jslast(-1),nadded(0),k;
         /* t initialization makes the average window centered on averaging
          * window */
         for(i=0,t=(this->t0)+time_avlen/2.0;i<ns;++i,t+=(this->dt))
@@ -330,25 +983,58 @@ PMTimeSeries::PMTimeSeries(MWTBundle& d, int band, int timesteps, int avlen,
             TimeWindow tw(t,t+time_avlen);
             if ( tw.end < x[0].endtime() )
             {
-                for(iw=0;iw<nw;++iw)
-                    pmi.push_back(ParticleMotionEllipse(x[iw],y[iw],z[iw],tw,up));
-                ComputePMStats(pmi,avg,err,confidence,ntrials);
-                pmdata.push_back(avg);
-                pmerr.push_back(err);
-                pmi.clear();
+                if(control.incremental_covariance)
+                {
+                    js=x[0].sample_number(t);
+                    if((js<0) || ((js+ntw)>x[0].ns)) break;
+                    int shift=js-jslast;
+                    bool rebuild=((jslast<0) || (shift<0) || (shift>=ntw)
+                            || (nadded>=ntw));
+                    for(iw=0;iw<nw;++iw)
+                    {
+                        if(rebuild)
+                        {
+                            cov[iw].zero();
+                            for(k=js;k<js+ntw;++k)
+                                cov[iw].add(x[iw].s[k],y[iw].s[k],z[iw].s[k]);
+                        }
+                        else
+                        {
+                            for(k=jslast;k<js;++k)
+                                cov[iw].remove(x[iw].s[k],y[iw].s[k],z[iw].s[k]);
+                            for(k=jslast+ntw;k<js+ntw;++k)
+                                cov[iw].add(x[iw].s[k],y[iw].s[k],z[iw].s[k]);
+                        }
+                        pmw.push_back(ParticleMotionEllipse(cov[iw],up));
+                    }
+                    if(rebuild)
+                        nadded=0;
+                    else
+                        nadded+=shift;
+                    jslast=js;
+                }
+                else
+                {
+                    for(iw=0;iw<nw;++iw)
+                        pmw.push_back(ParticleMotionEllipse(x[iw],y[iw],z[iw],tw,up));
+                }
+                ++nsout;
             }
             else { break; }
         }
+        this->set_random_streams(band,control);
+        this->compute_statistics(pmw,nsout,nw,nw,1,confidence,ntrials,control);
         /* Reset ns if necessary.   Do this silently unless ns is 0 or less */
-        if(pmdata.size()<=0) throw SeisppError(base_error
+        if(pmcols.size()<=0) throw SeisppError(base_error
                 + "Data window is too short for specified parameters - zero length PMTimeSeries result");
-        if((this->ns) != pmdata.size()) this->ns = pmdata.size();
+        if((this->ns) != pmcols.size()) this->ns = pmcols.size();
         this->post_attributes_to_metadata();
+        this->post_edge_trim(x[0]);
         live=true;
     }catch(...){throw;};
 }
 PMTimeSeries::PMTimeSeries(MWTBundle& d, int band, double confidence,
-        int bsmultiplier)
+        int bsmultiplier, const PMTimeSeriesControl& control)
     : Metadata(dynamic_cast<Metadata&>(d))
 {
     const string base_error("PMTimeSeries sample-by-sample constructor:  ");
@@ -368,16 +1054,20 @@ PMTimeSeries::PMTimeSeries(MWTBundle& d, int band, double confidence,
         averaging_length=1;
         f0=d.get_f0(band);
         fw=d.get_fw(band);
-        /* In this version the step size is always the sample interval
-         * so we don't have the complications in computing dt for 
-         * the constructor that uses time averaging (immediately above)*/
-        dt=d.sample_interval(band);
-        decfac=d.get_decfac(band);
         /* We compute the time duration of the wavelet used.  transform
          * has this is samples bu the complexity of timesteps being other
          * than 1 requires we compute it in seconds */
         wavelet_duration=(d.sample_interval(band))
                          *((double)(d.get_wavelet_length(band)));
+        /* The step size is a fixed multiple of the sample interval so 
+         * we don't have the complications in computing dt for 
+         * the constructor that uses time averaging (immediately above)*/
+        int stride=control.output_stride;
+        if(stride<=0) 
+            stride=PMAutomaticStride(fw,wavelet_duration,
+                    d.sample_interval(band));
+        dt=d.sample_interval(band)*((double)stride);
+        decfac=d.get_decfac(band)*stride;
         int iw,i;
         double up[3]={0.0,0.0,1.0};
         vector<MWTwaveform> x,y,z;
@@ -389,6 +1079,9 @@ PMTimeSeries::PMTimeSeries(MWTBundle& d, int band, double confidence,
             y.push_back(d(band,iw,1));
             z.push_back(d(band,iw,2));
         }
+        if(control.trim_wavelet_edges) trim_band_edges(x,y,z);
+        if(x[0].ns<=0) throw SeisppError(base_error
+            + "No data in this band.  Data window may be shorter than the wavelet");
         /* These are required attributes from BasicTimeSeries.  We have
            to assume we can estract them from the components we just
            built. */
@@ -418,37 +1111,285 @@ PMTimeSeries::PMTimeSeries(MWTBundle& d, int band, double confidence,
                 throw SeisppError(base_error + ss.str());
             }
         }
-        vector<ParticleMotionEllipse> pmi;   // nw estimates for each i
-        ParticleMotionEllipse avg;
-        ParticleMotionError err;
-        pmi.reserve(nw);
-        for(i=0;i<ns;++i)
+        /* Output sample i is input sample i*stride.   t0 is unchanged.
+           nsin is the number of input samples. */
+        int nsin=ns;
+        ns = nsin>0 ? (nsin-1)/stride+1 : 0;
+        /* Compute all the ellipses for each wavelet in one call to the
+           batched ellipse procedure.  That requires splitting the 
+           complex samples into structure of arrays form.  pmw is 
+           an nw by ns matrix stored with samples sequential.*/
+        vector<ParticleMotionEllipse> pmw(nw*ns);
+        vector<double> xr(ns),xi(ns),yr(ns),yi(ns),zr(ns),zi(ns);
+        int is;
+        for(iw=0;iw<nw;++iw)
         {
-            for(iw=0;iw<nw;++iw)
+            for(i=0,is=0;i<ns;++i,is+=stride)
             {
-                pmi.push_back(ParticleMotionEllipse(x[iw].s[i],y[iw].s[i],z[iw].s[i],up));
+                xr[i]=x[iw].s[is].real();
+                xi[i]=x[iw].s[is].imag();
+                yr[i]=y[iw].s[is].real();
+                yi[i]=y[iw].s[is].imag();
+                zr[i]=z[iw].s[is].real();
+                zi[i]=z[iw].s[is].imag();
             }
-            ComputePMStats(pmi,avg,err,confidence,ntrials);
-            pmdata.push_back(avg);
-            pmerr.push_back(err);
-            pmi.clear();
+            ParticleMotionEllipseBatch(ns,&(xr[0]),&(xi[0]),&(yr[0]),&(yi[0]),
+                    &(zr[0]),&(zi[0]),up,&(pmw[iw*ns]));
         }
+        this->set_random_streams(band,control);
+        this->compute_statistics(pmw,ns,nw,1,ns,confidence,ntrials,control);
         // Safer to force setting number of samples to actual size of data vector
-        this->ns=pmdata.size();
+        this->ns=pmcols.size();
         this->post_attributes_to_metadata();
+        /* Report the stride and the work it saved.  Each skipped 
+           sample is one ComputePMStats call (five bootstrap runs) */
+        this->put("output_stride",stride);
+        this->put("bootstrap_estimates_saved",nsin-(this->ns));
+        this->post_edge_trim(x[0]);
         live=true;
     }catch(...){throw;};
 }
+/* PMColumns methods.  These are all simple scatter/gather operations
+   between the columns and the ellipse and error objects. */
+void PMColumns::reserve(int n)
+{
+    for(int k=0;k<3;++k)
+    {
+        major[k].reserve(n);
+        minor[k].reserve(n);
+    }
+    majornrm.reserve(n);
+    minornrm.reserve(n);
+    dtheta_major.reserve(n);
+    dphi_major.reserve(n);
+    dtheta_minor.reserve(n);
+    dphi_minor.reserve(n);
+    dmajornrm.reserve(n);
+    dminornrm.reserve(n);
+    delta_rect.reserve(n);
+    ndgf_major.reserve(n);
+    ndgf_minor.reserve(n);
+    ndgf_rect.reserve(n);
+    ndgf_major_amp.reserve(n);
+    ndgf_minor_amp.reserve(n);
+    ntrials.reserve(n);
+    estimated.reserve(n);
+}
+void PMColumns::resize(int n)
+{
+    for(int k=0;k<3;++k)
+    {
+        major[k].resize(n,0.0);
+        minor[k].resize(n,0.0);
+    }
+    majornrm.resize(n,0.0);
+    minornrm.resize(n,0.0);
+    dtheta_major.resize(n,0.0);
+    dphi_major.resize(n,0.0);
+    dtheta_minor.resize(n,0.0);
+    dphi_minor.resize(n,0.0);
+    dmajornrm.resize(n,0.0);
+    dminornrm.resize(n,0.0);
+    delta_rect.resize(n,0.0);
+    ndgf_major.resize(n,0);
+    ndgf_minor.resize(n,0);
+    ndgf_rect.resize(n,0);
+    ndgf_major_amp.resize(n,0);
+    ndgf_minor_amp.resize(n,0);
+    ntrials.resize(n,0);
+    estimated.resize(n,false);
+}
+/* Helpers for PMColumns append and erase_front - every column is 
+   handled the same way */
+template <class T> static void append_column(vector<T>& a, const vector<T>& b)
+{
+    a.insert(a.end(),b.begin(),b.end());
+}
+template <class T> static void erase_column_front(vector<T>& a, int n)
+{
+    a.erase(a.begin(),a.begin()+n);
+}
+void PMColumns::append(const PMColumns& d)
+{
+    for(int k=0;k<3;++k)
+    {
+        append_column(major[k],d.major[k]);
+        append_column(minor[k],d.minor[k]);
+    }
+    append_column(majornrm,d.majornrm);
+    append_column(minornrm,d.minornrm);
+    append_column(dtheta_major,d.dtheta_major);
+    append_column(dphi_major,d.dphi_major);
+    append_column(dtheta_minor,d.dtheta_minor);
+    append_column(dphi_minor,d.dphi_minor);
+    append_column(dmajornrm,d.dmajornrm);
+    append_column(dminornrm,d.dminornrm);
+    append_column(delta_rect,d.delta_rect);
+    append_column(ndgf_major,d.ndgf_major);
+    append_column(ndgf_minor,d.ndgf_minor);
+    append_column(ndgf_rect,d.ndgf_rect);
+    append_column(ndgf_major_amp,d.ndgf_major_amp);
+    append_column(ndgf_minor_amp,d.ndgf_minor_amp);
+    append_column(ntrials,d.ntrials);
+    append_column(estimated,d.estimated);
+}
+void PMColumns::erase_front(int n)
+{
+    if(n<=0) return;
+    if(n>=this->size())
+    {
+        this->resize(0);
+        return;
+    }
+    for(int k=0;k<3;++k)
+    {
+        erase_column_front(major[k],n);
+        erase_column_front(minor[k],n);
+    }
+    erase_column_front(majornrm,n);
+    erase_column_front(minornrm,n);
+    erase_column_front(dtheta_major,n);
+    erase_column_front(dphi_major,n);
+    erase_column_front(dtheta_minor,n);
+    erase_column_front(dphi_minor,n);
+    erase_column_front(dmajornrm,n);
+    erase_column_front(dminornrm,n);
+    erase_column_front(delta_rect,n);
+    erase_column_front(ndgf_major,n);
+    erase_column_front(ndgf_minor,n);
+    erase_column_front(ndgf_rect,n);
+    erase_column_front(ndgf_major_amp,n);
+    erase_column_front(ndgf_minor_amp,n);
+    erase_column_front(ntrials,n);
+    erase_column_front(estimated,n);
+}
+void PMColumns::push_back(const ParticleMotionEllipse& e, 
+        const ParticleMotionError& err)
+{
+    int i=this->size();
+    this->resize(i+1);
+    this->set_ellipse(i,e);
+    this->set_errors(i,err);
+}
+void PMDeferredErrors::resize(int n)
+{
+    for(int k=0;k<3;++k)
+    {
+        major[k].resize(n);
+        minor[k].resize(n);
+    }
+    majornrm.resize(n);
+    minornrm.resize(n);
+}
+void PMDeferredErrors::set(int i, const ParticleMotionEllipse& e)
+{
+    for(int k=0;k<3;++k)
+    {
+        major[k][i]=(float)e.major[k];
+        minor[k][i]=(float)e.minor[k];
+    }
+    majornrm[i]=(float)e.majornrm;
+    minornrm[i]=(float)e.minornrm;
+}
+ParticleMotionEllipse PMDeferredErrors::get(int i) const
+{
+    ParticleMotionEllipse e;
+    for(int k=0;k<3;++k)
+    {
+        e.major[k]=major[k][i];
+        e.minor[k]=minor[k][i];
+    }
+    e.majornrm=majornrm[i];
+    e.minornrm=minornrm[i];
+    return e;
+}
+void PMDeferredErrors::erase_front(int n)
+{
+    if(n<=0) return;
+    for(int k=0;k<3;++k)
+    {
+        erase_column_front(major[k],n);
+        erase_column_front(minor[k],n);
+    }
+    erase_column_front(majornrm,n);
+    erase_column_front(minornrm,n);
+}
+ParticleMotionEllipse PMColumns::get_ellipse(int i) const
+{
+    ParticleMotionEllipse e;
+    for(int k=0;k<3;++k)
+    {
+        e.major[k]=major[k][i];
+        e.minor[k]=minor[k][i];
+    }
+    e.majornrm=majornrm[i];
+    e.minornrm=minornrm[i];
+    return(e);
+}
+ParticleMotionError PMColumns::get_errors(int i) const
+{
+    ParticleMotionError err;
+    err.dtheta_major=dtheta_major[i];
+    err.dphi_major=dphi_major[i];
+    err.dtheta_minor=dtheta_minor[i];
+    err.dphi_minor=dphi_minor[i];
+    err.dmajornrm=dmajornrm[i];
+    err.dminornrm=dminornrm[i];
+    err.delta_rect=delta_rect[i];
+    err.ndgf_major=ndgf_major[i];
+    err.ndgf_minor=ndgf_minor[i];
+    err.ndgf_rect=ndgf_rect[i];
+    err.ndgf_major_amp=ndgf_major_amp[i];
+    err.ndgf_minor_amp=ndgf_minor_amp[i];
+    err.ntrials=ntrials[i];
+    err.estimated=estimated[i];
+    return(err);
+}
+void PMColumns::set_ellipse(int i, const ParticleMotionEllipse& e)
+{
+    for(int k=0;k<3;++k)
+    {
+        major[k][i]=e.major[k];
+        minor[k][i]=e.minor[k];
+    }
+    majornrm[i]=e.majornrm;
+    minornrm[i]=e.minornrm;
+}
+void PMColumns::set_errors(int i, const ParticleMotionError& err)
+{
+    dtheta_major[i]=err.dtheta_major;
+    dphi_major[i]=err.dphi_major;
+    dtheta_minor[i]=err.dtheta_minor;
+    dphi_minor[i]=err.dphi_minor;
+    dmajornrm[i]=err.dmajornrm;
+    dminornrm[i]=err.dminornrm;
+    delta_rect[i]=err.delta_rect;
+    ndgf_major[i]=err.ndgf_major;
+    ndgf_minor[i]=err.ndgf_minor;
+    ndgf_rect[i]=err.ndgf_rect;
+    ndgf_major_amp[i]=err.ndgf_major_amp;
+    ndgf_minor_amp[i]=err.ndgf_minor_amp;
+    ntrials[i]=err.ntrials;
+    estimated[i]=err.estimated;
+}
+void PMColumns::zero(int i)
+{
+    this->set_ellipse(i,ParticleMotionEllipse());
+    this->set_errors(i,ParticleMotionError());
+}
 PMTimeSeries::PMTimeSeries(const PMTimeSeries& parent)
     : BasicTimeSeries(dynamic_cast<const BasicTimeSeries&> (parent)),
             Metadata(dynamic_cast<const Metadata&> (parent)),
-              pmdata(parent.pmdata),  pmerr(parent.pmerr)
+              pmcols(parent.pmcols), deferred(parent.deferred)
 {
     f0=parent.f0;
     fw=parent.fw;
     averaging_length=parent.averaging_length;
     decfac=parent.decfac;
     wavelet_duration=parent.wavelet_duration;
+    rng_seed=parent.rng_seed;
+    rng_band=parent.rng_band;
+    rng_source=parent.rng_source;
 }
 
 PMTimeSeries& PMTimeSeries::operator=(const PMTimeSeries& parent)
@@ -460,52 +1401,79 @@ PMTimeSeries& PMTimeSeries::operator=(const PMTimeSeries& parent)
         averaging_length=parent.averaging_length;
         decfac=parent.decfac;
         wavelet_duration=parent.wavelet_duration;
+        rng_seed=parent.rng_seed;
+        rng_band=parent.rng_band;
+        rng_source=parent.rng_source;
         this->BasicTimeSeries::operator=(parent);
         this->Metadata::operator=(parent);
-        this->pmdata=parent.pmdata;
-        this->pmerr=parent.pmerr;
+        this->pmcols=parent.pmcols;
+        this->deferred=parent.deferred;
     }
     return *this;
 }
 
 
 vector<ParticleMotionEllipse> PMTimeSeries::get_pmdata() {
-    return(pmdata);
+    vector<ParticleMotionEllipse> result;
+    result.reserve(pmcols.size());
+    for(int i=0;i<pmcols.size();++i) 
+        result.push_back(pmcols.get_ellipse(i));
+    return(result);
 };
 
 vector<ParticleMotionError> PMTimeSeries::get_pmerr() {
-    return(pmerr);
+    this->evaluate_errors();
+    vector<ParticleMotionError> result;
+    result.reserve(pmcols.size());
+    for(int i=0;i<pmcols.size();++i) 
+        result.push_back(pmcols.get_errors(i));
+    return(result);
 };
 
 
 /* Both of the following routines could use the at() method of std::vector
    but I use a custom test to allow me to throw a SeisppError, which is
    consistent with the rest of this code. */
-ParticleMotionEllipse& PMTimeSeries::ellipse(int i)
+ParticleMotionEllipse PMTimeSeries::ellipse(int i)
 {
-    if(i<0 || i>=pmdata.size())
+    if(i<0 || i>=pmcols.size())
     {
         stringstream ss;
         ss << "PMTimeSeries::ellipse method:  "
             << "request for sample number "<<i
-            << " is outside data range of "<< pmdata.size()<<endl;
+            << " is outside data range of "<< pmcols.size()<<endl;
         throw SeisppError(ss.str());
     }
     else
-        return(pmdata[i]);
+        return(pmcols.get_ellipse(i));
+}
+void PMTimeSeries::set_ellipse(int i, const ParticleMotionEllipse& e)
+{
+    if(i<0 || i>=pmcols.size())
+    {
+        stringstream ss;
+        ss << "PMTimeSeries::set_ellipse method:  "
+            << "request for sample number "<<i
+            << " is outside data range of "<< pmcols.size()<<endl;
+        throw SeisppError(ss.str());
+    }
+    pmcols.set_ellipse(i,e);
 }
 ParticleMotionError PMTimeSeries::errors(int i)
 {
-    if(i<0 || i>=pmerr.size())
+    if(i<0 || i>=pmcols.size())
     {
         stringstream ss;
         ss << "PMTimeSeries::errors method:  "
             << "request for sample number "<<i
-            << " is outside data range of "<< pmerr.size()<<endl;
+            << " is outside data range of "<< pmcols.size()<<endl;
         throw SeisppError(ss.str());
     }
     else
-        return(pmerr[i]);
+    {
+        if(deferred.npending>0) this->evaluate_errors(i,i+1);
+        return(pmcols.get_errors(i));
+    }
 }
 void PMTimeSeries::zero_gaps()
 {
@@ -528,207 +1496,249 @@ void PMTimeSeries::zero_gaps()
      	            iend = SEISPP::nint((this_gap->end-t0)/dt);
         	for(i=0;i<3;++i)
         	    for(int j=istart;j<=iend;++j)
+                    pmcols.zero(j);
+                /* Zeroed samples have no errors to compute */
+                for(int j=istart;j<=iend;++j)
                 {
-                    pmdata[j].zero();
-                    pmerr[j].zero();
+                    if((j<deferred.pending.size()) && deferred.pending[j])
+                    {
+                        deferred.pending[j]=false;
+                        --deferred.npending;
+                    }
                 }
     	}
+        if(deferred.npending<=0) deferred=PMDeferredErrors();
 }
 /* This is a series of methods to retrieve simplified representations of
  * the particle motion data as a function of time as time series 
  * objects.  In all cases the metadata is a copy of "this".   
- * This series of method are painfully paraellel.   There is probably
- * a way to have made this a template, but because the template 
- * variable is a method name I wasn't sure how to do that.*/
-TimeSeries PMTimeSeries::rectilinearity()
+ * This private method creates the common shell of the result.  
+ * Each metric is then computed by reading only the columns it needs.
+ * Formulas must match those of the ParticleMotionEllipse methods 
+ * with the same names. */
+TimeSeries PMTimeSeries::derived_time_series(string name)
+{
+    /* The metric loops do not range check so test once here.  The
+     * old per sample ellipse method calls would have thrown this */
+    if((this->ns)>pmcols.size())
+    {
+        stringstream ss;
+        ss << "PMTimeSeries::derived_time_series method:  "
+            << "ns="<<this->ns<<" exceeds number of samples stored="
+            << pmcols.size()<<endl;
+        throw SeisppError(ss.str());
+    }
+    TimeSeries dts(dynamic_cast<Metadata&>(*this),false);
+    dts.BasicTimeSeries::operator=(dynamic_cast<BasicTimeSeries&>(*this));
+    /* set this so we can have a clue what this object is. 
+     * PMDerivedTSType is defined in PMTimeSeries.h */
+    dts.put(PMDerivedTSType,name);
+    dts.s.resize(this->ns);
+    /* before returning be sure this is set true.   Original constructor
+     * does not set this flag*/
+    dts.live=true;
+    return dts;
+}
+/* Azimuth formula used by ParticleMotionEllipse::major_azimuth and 
+   minor_azimuth.   The zero test is written to reproduce what those
+   methods do. */
+static inline double pm_azimuth(double x, double y)
+{
+    if((x<FLT_EPSILON) && (fabs(y)<FLT_EPSILON))
+        return(0.0);
+    else
+        return(M_PI_2 - atan2(y,x));
+}
+string PMMetricName(PMMetric m)
+{
+    switch(m)
+    {
+        case PMRectilinearity:
+            return string("rectilinearity");
+        case PMMajorAmplitude:
+            return string("major_axis_amplitude");
+        case PMMinorAmplitude:
+            return string("minor_axis_amplitude");
+        case PMMajorAzimuth:
+            return string("major_azimuth");
+        case PMMajorInclination:
+            return string("major_inclination");
+        case PMMinorAzimuth:
+            return string("minor_azimuth");
+        case PMMinorInclination:
+            return string("minor_inclination");
+    };
+    return string("undefined");
+}
+/* Kernel for all the derived metric methods.  out[j] points to an
+   array of length ns for metric which[j].   The selection is sorted
+   out once so the loop over samples only computes what was requested
+   and reads each column once.  Formulas must match those of the 
+   ParticleMotionEllipse methods with the same names. */
+void PMColumns::fill_metrics(const vector<PMMetric>& which, int i0, int n,
+        double **out) const
+{
+    const int nmetrics(7);
+    double *o[nmetrics];
+    int i,j;
+    /* which indexes o so values cast from an int must be checked */
+    for(j=0;j<which.size();++j)
+    {
+        if((((int)which[j])<0) || (((int)which[j])>=nmetrics))
+        {
+            stringstream ss;
+            ss << "PMColumns::fill_metrics method:  "
+                << "illegal metric code="<<(int)which[j]
+                << " requested in position "<<j<<endl
+                << "Must be a PMMetric value (0 to "<<nmetrics-1<<")"<<endl;
+            throw SeisppError(ss.str());
+        }
+    }
+    for(j=0;j<nmetrics;++j) o[j]=NULL;
+    /* If a metric is requested more than once the first output gets
+       computed and the others are copied at the end */
+    for(j=0;j<which.size();++j)
+        if(o[which[j]]==NULL) o[which[j]]=out[j];
+    const double *majnrm=&(majornrm[i0]);
+    const double *minnrm=&(minornrm[i0]);
+    const double *maj0=&(major[0][i0]);
+    const double *maj1=&(major[1][i0]);
+    const double *maj2=&(major[2][i0]);
+    const double *min0=&(minor[0][i0]);
+    const double *min1=&(minor[1][i0]);
+    const double *min2=&(minor[2][i0]);
+    for(i=0;i<n;++i)
+    {
+        if(o[PMRectilinearity]!=NULL)
+        {
+            if(majnrm[i]>FLT_EPSILON)
+                o[PMRectilinearity][i]=1.0-minnrm[i]/majnrm[i];
+            else
+                o[PMRectilinearity][i]=0.0;
+        }
+        if(o[PMMajorAmplitude]!=NULL) o[PMMajorAmplitude][i]=majnrm[i];
+        if(o[PMMinorAmplitude]!=NULL) o[PMMinorAmplitude][i]=minnrm[i];
+        if(o[PMMajorAzimuth]!=NULL) 
+            o[PMMajorAzimuth][i]=pm_azimuth(maj0[i],maj1[i]);
+        if(o[PMMajorInclination]!=NULL) 
+            o[PMMajorInclination][i]=acos(maj2[i]);
+        if(o[PMMinorAzimuth]!=NULL) 
+            o[PMMinorAzimuth][i]=pm_azimuth(min0[i],min1[i]);
+        if(o[PMMinorInclination]!=NULL) 
+            o[PMMinorInclination][i]=acos(min2[i]);
+    }
+    for(j=0;j<which.size();++j)
+        if(out[j]!=o[which[j]])
+            for(i=0;i<n;++i) out[j][i]=o[which[j]][i];
+}
+void PMTimeSeries::fill_metrics(const vector<PMMetric>& which, double **out)
+{
+    pmcols.fill_metrics(which,0,this->ns,out);
+}
+void PMTimeSeries::metrics(const vector<PMMetric>& which, dmatrix& result)
+{
+    if( (result.rows()!=(this->ns)) || (result.columns()!=which.size()) )
+    {
+        stringstream ss;
+        ss << "PMTimeSeries::metrics method:  "
+            << "result matrix size is "<<result.rows()<<"x"
+            << result.columns()<<" but must be "<<this->ns<<"x"
+            << which.size()<<endl;
+        throw SeisppError(ss.str());
+    }
+    if(((this->ns)<=0) || (which.size()<=0)) return;
+    if((this->ns)>pmcols.size())
+    {
+        stringstream ss;
+        ss << "PMTimeSeries::metrics method:  "
+            << "ns="<<this->ns<<" exceeds number of samples stored="
+            << pmcols.size()<<endl;
+        throw SeisppError(ss.str());
+    }
+    vector<double *> out;
+    out.reserve(which.size());
+    for(int j=0;j<which.size();++j) out.push_back(result.get_address(0,j));
+    this->fill_metrics(which,&(out[0]));
+}
+vector<TimeSeries> PMTimeSeries::metrics(const vector<PMMetric>& which)
 {
     try{
-        TimeSeries dts(dynamic_cast<Metadata&>(*this),false);
-        dts.BasicTimeSeries::operator=(dynamic_cast<BasicTimeSeries&>(*this));
-        /* set this so we can have a clue what this object is. 
-         * PMDerivedTSType is defined in PMTimeSeries.h */
-        dts.put(PMDerivedTSType,"rectilinearity");
-        /* The following would normally be useful but the TimeSeries
-         * constuctor does this so we drop it.  Left here in case 
-         * that changes. 
-        dts.reserve(this->ns);  
-        */
-        int i,k;
-        for(i=0;i<(this->ns);++i)
+        vector<TimeSeries> result;
+        if(which.size()<=0) return result;
+        TimeSeries dts=this->derived_time_series(PMMetricName(which[0]));
+        result.reserve(which.size());
+        vector<double *> out;
+        out.reserve(which.size());
+        for(int j=0;j<which.size();++j)
         {
-            ParticleMotionEllipse pmd=this->ellipse(i);
-            dts.s.push_back(pmd.rectilinearity());
+            result.push_back(dts);
+            result[j].put(PMDerivedTSType,PMMetricName(which[j]));
         }
-        /* before returning be sure this is set true.   Original constructor
-         * does not set this flag*/
-        dts.live=true;
-        return dts;
+        if((this->ns)<=0) return result;
+        for(int j=0;j<which.size();++j) out.push_back(&(result[j].s[0]));
+        this->fill_metrics(which,&(out[0]));
+        return result;
+    }catch(...){throw;};
+}
+/* The single metric methods are all a special case of metrics */
+TimeSeries PMTimeSeries::rectilinearity()
+{
+    try{
+        vector<PMMetric> which(1,PMRectilinearity);
+        return(this->metrics(which)[0]);
     }catch(...){throw;};
 }
 TimeSeries PMTimeSeries::major_axis_amplitude()
 {
     try{
-        TimeSeries dts(dynamic_cast<Metadata&>(*this),false);
-        dts.BasicTimeSeries::operator=(dynamic_cast<BasicTimeSeries&>(*this));
-        /* set this so we can have a clue what this object is. 
-         * PMDerivedTSType is defined in PMTimeSeries.h */
-        dts.put(PMDerivedTSType,"major_axis_amplitude");
-        /* The following would normally be useful but the TimeSeries
-         * constuctor does this so we drop it.  Left here in case 
-         * that changes. 
-        dts.reserve(this->ns);  
-        */
-        int i,k;
-        for(i=0;i<(this->ns);++i)
-        {
-            ParticleMotionEllipse pmd=this->ellipse(i);
-            dts.s.push_back(pmd.majornrm);
-        }
-
-        /* before returning be sure this is set true.   Original constructor
-         * does not set this flag*/
-        dts.live=true;
-        return dts;
+        vector<PMMetric> which(1,PMMajorAmplitude);
+        return(this->metrics(which)[0]);
     }catch(...){throw;};
 }
 TimeSeries PMTimeSeries::minor_axis_amplitude()
 {
     try{
-        TimeSeries dts(dynamic_cast<Metadata&>(*this),false);
-        dts.BasicTimeSeries::operator=(dynamic_cast<BasicTimeSeries&>(*this));
-        /* set this so we can have a clue what this object is. 
-         * PMDerivedTSType is defined in PMTimeSeries.h */
-        dts.put(PMDerivedTSType,"minor_axis_amplitude");
-        /* The following would normally be useful but the TimeSeries
-         * constuctor does this so we drop it.  Left here in case 
-         * that changes. 
-        dts.reserve(this->ns);  
-        */
-        int i,k;
-        for(i=0;i<(this->ns);++i)
-        {
-            ParticleMotionEllipse pmd=this->ellipse(i);
-            dts.s.push_back(pmd.minornrm);
-        }
-
-        /* before returning be sure this is set true.   Original constructor
-         * does not set this flag*/
-        dts.live=true;
-        return dts;
+        vector<PMMetric> which(1,PMMinorAmplitude);
+        return(this->metrics(which)[0]);
     }catch(...){throw;};
 }
 TimeSeries PMTimeSeries::major_azimuth()
 {
     try{
-        TimeSeries dts(dynamic_cast<Metadata&>(*this),false);
-        dts.BasicTimeSeries::operator=(dynamic_cast<BasicTimeSeries&>(*this));
-        /* set this so we can have a clue what this object is. 
-         * PMDerivedTSType is defined in PMTimeSeries.h */
-        dts.put(PMDerivedTSType,"major_azimuth");
-        /* The following would normally be useful but the TimeSeries
-         * constuctor does this so we drop it.  Left here in case 
-         * that changes. 
-        dts.reserve(this->ns);  
-        */
-        int i,k;
-        for(i=0;i<(this->ns);++i)
-        {
-            ParticleMotionEllipse pmd=this->ellipse(i);
-            dts.s.push_back(pmd.major_azimuth());
-        }
-
-        /* before returning be sure this is set true.   Original constructor
-         * does not set this flag*/
-        dts.live=true;
-        return dts;
+        vector<PMMetric> which(1,PMMajorAzimuth);
+        return(this->metrics(which)[0]);
     }catch(...){throw;};
 }
 TimeSeries PMTimeSeries::major_inclination()
 {
     try{
-        TimeSeries dts(dynamic_cast<Metadata&>(*this),false);
-        dts.BasicTimeSeries::operator=(dynamic_cast<BasicTimeSeries&>(*this));
-        /* set this so we can have a clue what this object is. 
-         * PMDerivedTSType is defined in PMTimeSeries.h */
-        dts.put(PMDerivedTSType,"major_inclination");
-        /* The following would normally be useful but the TimeSeries
-         * constuctor does this so we drop it.  Left here in case 
-         * that changes. 
-        dts.reserve(this->ns);  
-        */
-        int i,k;
-        for(i=0;i<(this->ns);++i)
-        {
-            ParticleMotionEllipse pmd=this->ellipse(i);
-            dts.s.push_back(pmd.major_inclination());
-        }
-
-        /* before returning be sure this is set true.   Original constructor
-         * does not set this flag*/
-        dts.live=true;
-        return dts;
+        vector<PMMetric> which(1,PMMajorInclination);
+        return(this->metrics(which)[0]);
     }catch(...){throw;};
 }
 TimeSeries PMTimeSeries::minor_azimuth()
 {
     try{
-        TimeSeries dts(dynamic_cast<Metadata&>(*this),false);
-        dts.BasicTimeSeries::operator=(dynamic_cast<BasicTimeSeries&>(*this));
-        /* set this so we can have a clue what this object is. 
-         * PMDerivedTSType is defined in PMTimeSeries.h */
-        dts.put(PMDerivedTSType,"minor_azimuth");
-        /* The following would normally be useful but the TimeSeries
-         * constuctor does this so we drop it.  Left here in case 
-         * that changes. 
-        dts.reserve(this->ns);  
-        */
-        int i,k;
-        for(i=0;i<(this->ns);++i)
-        {
-            ParticleMotionEllipse pmd=this->ellipse(i);
-            dts.s.push_back(pmd.minor_azimuth());
-        }
-
-        /* before returning be sure this is set true.   Original constructor
-         * does not set this flag*/
-        dts.live=true;
-        return dts;
+        vector<PMMetric> which(1,PMMinorAzimuth);
+        return(this->metrics(which)[0]);
     }catch(...){throw;};
 }
 TimeSeries PMTimeSeries::minor_inclination()
 {
     try{
-        TimeSeries dts(dynamic_cast<Metadata&>(*this),false);
-        dts.BasicTimeSeries::operator=(dynamic_cast<BasicTimeSeries&>(*this));
-        /* set this so we can have a clue what this object is. 
-         * PMDerivedTSType is defined in PMTimeSeries.h */
-        dts.put(PMDerivedTSType,"minor_inclination");
-        /* The following would normally be useful but the TimeSeries
-         * constuctor does this so we drop it.  Left here in case 
-         * that changes. 
-        dts.reserve(this->ns);  
-        */
-        int i,k;
-        for(i=0;i<(this->ns);++i)
-        {
-            ParticleMotionEllipse pmd=this->ellipse(i);
-            dts.s.push_back(pmd.minor_inclination());
-        }
-
-        /* before returning be sure this is set true.   Original constructor
-         * does not set this flag*/
-        dts.live=true;
-        return dts;
+        vector<PMMetric> which(1,PMMinorInclination);
+        return(this->metrics(which)[0]);
     }catch(...){throw;};
 }
 ostream& operator<<(ostream& os, PMTimeSeries& d)
 {
+    d.evaluate_errors();
     os << dynamic_cast<Metadata&>(d)<<endl;
     int i,k;
     for(i=0;i<d.ns;++i)
     {
-        ParticleMotionEllipse pmd=d.ellipse(i);
-        ParticleMotionError pme=d.errors(i);
+        ParticleMotionEllipse pmd=d.pmcols.get_ellipse(i);
+        ParticleMotionError pme=d.pmcols.get_errors(i);
         for(k=0;k<3;++k) os << pmd.major[k]*pmd.majornrm<<" ";
         for(k=0;k<3;++k) os << pmd.minor[k]*pmd.minornrm<<" ";
         os << pme.dtheta_major<<" "
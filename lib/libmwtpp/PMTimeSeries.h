@@ -8,6 +8,8 @@
 #include "Metadata.h"
 #include "ParticleMotionEllipse.h"
 #include "ParticleMotionError.h"
+#include "CounterRNG.h"
+#include "Vector3DBootstrapError.h"
 using namespace SEISPP;
 /*! \brief Time series style representation of particle motion ellipse data.
  *
@@ -34,6 +36,425 @@ const string PMDerivedTSType("DerivedTSDataType");
  * */
 const double thetafloor(0.017453292519943);
 const double error_inclination_floor(0.17453292519943);
+/*! \brief Methods available to compute particle motion error estimates.
+
+  PMBootstrapErrors is the original bootstrap.  PMJackknifeErrors uses
+  the delete-one jackknife (see MultiStatisticBootstrap::run_jackknife)
+  which needs only one resample per wavelet and is intended for quick
+  look and real time processing. */
+enum PMErrorEstimator {PMBootstrapErrors, PMJackknifeErrors};
+/*! Return the name of an error estimator ("bootstrap" or "jackknife").
+  These are the values of the pf key error_estimator. */
+string PMErrorEstimatorName(PMErrorEstimator e);
+/*! \brief Optional algorithm choices for PMTimeSeries constructors.
+
+  The PMTimeSeries constructors have a long list of numerical 
+  parameters.   Choices of algorithm that do not change the meaning
+  of the result are collected in this object to keep the constructor 
+  argument lists manageable.   Like ParticleMotionError this is 
+  essentially a struct with public attributes.  The default 
+  constructor gives the original behavior of the constructors. */
+class PMTimeSeriesControl
+{
+public:
+    /*! \brief Use a sliding window covariance in time averaging constructor.
+
+      When true the time averaging constructor keeps the 3x3 
+      covariance matrix of each wavelet's window as a running sum
+      updated by adding samples entering the window and removing 
+      samples leaving it.  The ellipse is then computed from that 
+      matrix. Cost per output step is proportional to the time step
+      instead of the averaging length.  Sums are rebuilt from scratch
+      each time the window has fully turned over to bound roundoff 
+      drift.  This assumes the transform data have no gaps, which 
+      is always true for MWTwaveform data. Default is false. */
+    bool incremental_covariance;
+    /*! \brief Output sample stride for the sample by sample constructor.
+
+      The sample by sample constructor normally computes an ellipse 
+      and a full set of bootstrap error estimates at every sample of
+      the band.   For narrow bands the results are heavily 
+      oversampled.  When this is an integer n>1 only every nth sample
+      is computed and the output sample interval is n times the 
+      band's sample interval.  A value of 0 (or negative) selects
+      the stride automatically from the band's bandwidth and 
+      wavelet duration (see PMAutomaticStride).  Default is 1 
+      (every sample).   The time averaging constructor ignores this
+      parameter as its timesteps argument does the same thing. */
+    int output_stride;
+    /*! \brief Absolute amplitude gate for bootstrap error estimation.
+
+      Bootstrap error estimation is the dominant cost of building a
+      PMTimeSeries.   Samples whose average major axis length is 
+      below a gate level get the average ellipse (computed without
+      the bootstrap) and a ParticleMotionError with estimated set 
+      false.  The gate level is the larger of this value and 
+      bootstrap_gate_noise_multiple times the noise RMS.  0 (default)
+      disables this gate.  */
+    double bootstrap_gate_threshold;
+    /*! \brief Noise relative amplitude gate for bootstrap error estimation.
+
+      When positive the RMS of the average major axis length is 
+      computed for samples in the time window from 
+      bootstrap_gate_noise_start to bootstrap_gate_noise_end and the 
+      gate level is set to this multiple of that RMS (or 
+      bootstrap_gate_threshold if that is larger).  Times are in the 
+      same time base as the data (normally relative to an arrival).
+      0 (default) disables this gate. */
+    double bootstrap_gate_noise_multiple;
+    /*! \brief Defer bootstrap error estimation until errors are requested.
+
+      When true the constructors compute only the average ellipse for
+      each sample (see bootstrap gating for how that is computed 
+      without the bootstrap).  The per wavelet ellipse estimates are
+      kept and the error estimates for a sample are computed and 
+      cached the first time they are requested with the errors method
+      or evaluate_errors.  Jobs that only use the ellipses never pay 
+      for the bootstrap.  
+
+      Ellipses are the average of the wavelet estimates (see 
+      ComputePMStats) with or without this option and are never 
+      changed when the errors are computed.  Errors computed later 
+      are identical to those computed without deferral.  The wavelet
+      estimates are kept in single precision (32 bytes per wavelet 
+      per sample) until all errors are computed.  Default is false. */
+    bool lazy_errors;
+    /*! \brief Restrict estimates to the interior of each band.
+
+      Transform samples within half a wavelet length of the ends 
+      of the data are contaminated by edge effects.   When true the
+      constructors trim the band data to the fully supported interior
+      (see MWTwaveform::trim_edges) before computing anything.  Data
+      already trimmed by MWTransform are not trimmed again.  When 
+      the data were trimmed by either method the valid interval is 
+      posted to metadata as valid_starttime and valid_endtime and the
+      number of output samples not computed as 
+      edge_trim_estimates_saved.   Default is false.   The pf key is 
+      trim_wavelet_edges, the same key used by MWTransform. */
+    bool trim_wavelet_edges;
+    /*! \brief Seed for the bootstrap random number streams.
+
+      Each bootstrap estimate draws its resamples from a CounterRNG 
+      stream keyed by this seed, the sample number, the band, and the
+      sta and evid attributes.  Results are then identical for a given
+      seed no matter how or in what order they are computed.  0 
+      (default) means a seed is derived from the clock.  The seed 
+      actually used is posted to metadata as bootstrap_seed. */
+    long bootstrap_seed;
+    /*! \brief Stop the bootstrap early when the errors have converged.
+
+      The number of bootstrap trials is normally fixed at 
+      bsmultiplier times the number of wavelets for every sample.
+      When the estimates cluster tightly (e.g. highly rectilinear 
+      signals) the confidence intervals converge after a small 
+      fraction of those trials.   When true trials are run in batches
+      of bootstrap_batch_size and stop when no confidence interval 
+      changes by more than bootstrap_tolerance (relative) between 
+      batches.   The normal number of trials is the maximum.  The 
+      number actually used is stored for each sample in 
+      ParticleMotionError::ntrials.  Default is false. */
+    bool adaptive_bootstrap;
+    /*! Number of trials per batch for the adaptive bootstrap (default 100).*/
+    int bootstrap_batch_size;
+    /*! Relative convergence tolerance for the adaptive bootstrap 
+      (default 0.05).*/
+    double bootstrap_tolerance;
+    /*! \brief Method used to compute error estimates.
+
+      Default is PMBootstrapErrors.  PMJackknifeErrors reduces the 
+      cost of error estimation about 100 fold with the default 
+      bsmultiplier.  The bootstrap parameters (bsmultiplier and the 
+      adaptive options) are ignored for the jackknife.  The pf key 
+      is error_estimator with value bootstrap or jackknife.  The 
+      method used is posted to metadata with the same key. */
+    PMErrorEstimator error_estimator;
+    /*! \brief Share bootstrap resamples between samples.
+
+      Every sample has the same number of wavelet estimates so the 
+      bootstrap resamples (a trials by nw count matrix) can be the 
+      same for many samples.  When this is 0 (default) new resamples 
+      are drawn for every sample.  When positive one resample plan is
+      drawn for each block of this many consecutive samples and 
+      applied to all of them with one matrix product
+      (see MultiStatisticBootstrap::run_planned).  Negative means one
+      plan for the whole band.  This removes the random number 
+      generation from the per sample cost and makes the remaining 
+      arithmetic cache and BLAS friendly.
+
+      The cost is statistical independence between samples.  Each 
+      error estimate is still a valid bootstrap estimate, but the 
+      Monte Carlo error from the finite number of trials is the same
+      for all samples of a block.   A plan that happens to give 
+      narrow (or wide) intervals does so for the whole block, so 
+      errors vary more smoothly within a block than they should and 
+      can step at block boundaries.  Statistics that combine errors 
+      from many samples (e.g. averages over time) do not have their 
+      Monte Carlo error reduced by the number of samples combined.
+      Use a block length of about the wavelet duration to keep 
+      blocks shorter than the correlation length of the estimates,
+      or increase bsmultiplier if errors will be combined.  The 
+      setting is posted to metadata as bootstrap_plan_block.  Ignored
+      for the jackknife.  The adaptive bootstrap is not used with a 
+      shared plan. */
+    int bootstrap_plan_block;
+    /*! Start time of noise window used for bootstrap gating.*/
+    double bootstrap_gate_noise_start;
+    /*! End time of noise window used for bootstrap gating.*/
+    double bootstrap_gate_noise_end;
+    /*! Default constructor - sets all defaults. */
+    PMTimeSeriesControl();
+    /*! \brief Construct from a Metadata (normally a parameter file) object.
+
+      Any attribute not defined in md is silently set to the default.
+      Keys are the same as the attribute names of this object. 
+
+      \exception SeisppError is thrown if error_estimator is not
+        one of the names returned by PMErrorEstimatorName. */
+    PMTimeSeriesControl(Metadata& md);
+};
+/*! \brief Scalar metrics that can be derived from particle motion data.
+
+  Used to request several metrics in one call to PMTimeSeries::metrics.
+  Each has a method of the same concept in PMTimeSeries that returns
+  a single TimeSeries. */
+enum PMMetric {PMRectilinearity, PMMajorAmplitude, PMMinorAmplitude,
+    PMMajorAzimuth, PMMajorInclination, PMMinorAzimuth, PMMinorInclination};
+/*! Return the name posted as PMDerivedTSType for a metric.  These 
+  are the same as the names of the methods that compute the metric. */
+string PMMetricName(PMMetric m);
+/*! \brief Columnar (structure of arrays) store of particle motion data.
+
+  PMTimeSeries originally stored a vector of ParticleMotionEllipse 
+  objects and a parallel vector of ParticleMotionError objects.  
+  Most consumers want one attribute as a function of time (e.g. 
+  major axis amplitude or rectilinearity) and with that layout they 
+  stride through all the other attributes.   This object stores each
+  attribute in its own contiguous vector.   The attribute names are 
+  the same as those in ParticleMotionEllipse and ParticleMotionError
+  with the 3 vector components split into separate columns. 
+  All columns always have the same length.  
+
+  Like ParticleMotionError this is essentially a struct with public 
+  attributes.   Use the push_back, get, and set methods to keep the 
+  columns consistent.  */
+class PMColumns
+{
+public:
+    /*! Components of the unit vector along the major axis. */
+    vector<double> major[3];
+    /*! Components of the unit vector along the minor axis. */
+    vector<double> minor[3];
+    /*! Major and minor axis lengths */
+    vector<double> majornrm,minornrm;
+    /* Error estimates - see ParticleMotionError for definitions */
+    vector<double> dtheta_major,dphi_major,dtheta_minor,dphi_minor;
+    vector<double> dmajornrm,dminornrm,delta_rect;
+    vector<int> ndgf_major,ndgf_minor,ndgf_rect,ndgf_major_amp,ndgf_minor_amp;
+    vector<int> ntrials;
+    vector<bool> estimated;
+    /*! Return number of samples stored. */
+    int size() const {return(majornrm.size());};
+    /*! Reserve space for n samples in all columns. */
+    void reserve(int n);
+    /*! Resize all columns to n samples.  New samples are zeroed. */
+    void resize(int n);
+    /*! Append one sample. */
+    void push_back(const ParticleMotionEllipse& e, const ParticleMotionError& err);
+    /*! Gather sample i into a ParticleMotionEllipse.  No range checking.*/
+    ParticleMotionEllipse get_ellipse(int i) const;
+    /*! Gather sample i into a ParticleMotionError.  No range checking.*/
+    ParticleMotionError get_errors(int i) const;
+    /*! Scatter e into sample i.  No range checking.*/
+    void set_ellipse(int i, const ParticleMotionEllipse& e);
+    /*! Scatter err into sample i.  No range checking.*/
+    void set_errors(int i, const ParticleMotionError& err);
+    /*! Zero ellipse and error data for sample i. */
+    void zero(int i);
+    /*! Append all samples of d to the end of all columns. */
+    void append(const PMColumns& d);
+    /*! Remove the first n samples from all columns. */
+    void erase_front(int n);
+    /*! \brief Compute scalar metrics for a range of samples.
+
+      Computes each metric in which for samples i0 to i0+n-1 in a 
+      single pass through the columns.  The formulas are those of the 
+      ParticleMotionEllipse methods with the same names.  out[j] must 
+      point to space for n values of metric which[j].  No range 
+      checking is done on i0 and n.
+
+      \exception SeisppError is thrown if any member of which is not
+        a valid PMMetric value. */
+    void fill_metrics(const vector<PMMetric>& which, int i0, int n,
+            double **out) const;
+private:
+    friend class boost::serialization::access;
+    template<class Archive>
+        void serialize(Archive & ar, const unsigned int version)
+    {
+        for(int k=0;k<3;++k) ar & major[k];
+        for(int k=0;k<3;++k) ar & minor[k];
+        ar & majornrm;
+        ar & minornrm;
+        ar & dtheta_major;
+        ar & dphi_major;
+        ar & dtheta_minor;
+        ar & dphi_minor;
+        ar & dmajornrm;
+        ar & dminornrm;
+        ar & delta_rect;
+        ar & ndgf_major;
+        ar & ndgf_minor;
+        ar & ndgf_rect;
+        ar & ndgf_major_amp;
+        ar & ndgf_minor_amp;
+        if(version>0)
+            ar & estimated;
+        else
+            estimated.assign(majornrm.size(),true);
+        /* Trial counts were not saved before version 2 */
+        if(version>1)
+            ar & ntrials;
+        else
+            ntrials.assign(majornrm.size(),0);
+    };
+};
+BOOST_CLASS_VERSION(PMColumns,2);
+/*! \brief Compute the output stride used by the automatic sampling mode.
+
+  The ellipse parameters are phase invariant quadratic functions of the
+  transform output so they vary on the time scale of the band's 
+  envelope.  That has bandwidth fw so a sample interval of 1/(2*fw) 
+  samples it adequately.   The estimates are also smoothed over the 
+  wavelet duration so the interval is never allowed to exceed half
+  that length.  The stride returned is the largest integer multiple of 
+  dt no larger than the smaller of those two intervals, but always 
+  at least 1.
+
+  \param fw bandwidth of the band (Hz)
+  \param wavelet_duration length of the wavelets for the band (s)
+  \param dt sample interval of the band (s)
+  */
+int PMAutomaticStride(double fw, double wavelet_duration, double dt);
+/*! \brief Bootstrap average and errors of a set of ellipse estimates.
+
+  This is the procedure the PMTimeSeries constructors use to reduce
+  the estimates from each wavelet to one ellipse with error estimates.
+  The average ellipse is computed directly:  amplitudes are averaged 
+  in dB and axis directions are normalized vector means with the 
+  minor axis forced perpendicular to the major axis.   It does not 
+  depend on the bootstrap (it is the value the bootstrap center 
+  converges to) so it is the same for every error option.  The 
+  bootstrap sees the estimates rounded to single precision.
+
+  \param d ellipse estimates to be averaged (one per wavelet)
+  \param avg is set to the average ellipse
+  \param err is set to the error estimates
+  \param confidence_level confidence level for the errors
+  \param number_of_trials number of bootstrap trials
+  */
+void ComputePMStats(vector<ParticleMotionEllipse>& d,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials);
+/*! \brief ComputePMStats with resamples drawn from a given stream.
+
+  Same as the other version except the bootstrap resamples come from 
+  rng.  Results are reproducible and the procedure can be called from
+  multiple threads with a different rng in each.
+  */
+void ComputePMStats(vector<ParticleMotionEllipse>& d,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials, CounterRNG& rng);
+/*! \brief ComputePMStats with optional bootstrap algorithms.
+
+  Same as the CounterRNG version but the error options in control 
+  (error_estimator and the adaptive bootstrap options) are used.  number_of_trials is the 
+  maximum number of trials for the adaptive bootstrap.
+  */
+void ComputePMStats(vector<ParticleMotionEllipse>& d,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials, CounterRNG& rng,
+        const PMTimeSeriesControl& control);
+/*! \brief Work space for ComputePMStats.
+
+  ComputePMStats packs the wavelet estimates into arrays and runs a
+  MultiStatisticBootstrap on them.   Both need heap space.  When one
+  of these objects is reused for every sample of a series (one per 
+  thread if samples are computed in parallel) that space is sized by
+  the first call and later calls allocate nothing.   Contents are 
+  scratch and may be copied freely. */
+class PMStatsWorkspace
+{
+public:
+    MultiStatisticBootstrap bootstrap;
+    vector<double> scalars,vectors;
+};
+/*! \brief ComputePMStats with caller supplied work space.
+
+  This is the version used inside the library.  Results are the 
+  same as the control version.   The estimates need not be in a 
+  vector:  estimate i is d[i*stride].
+
+  \param d first estimate
+  \param nd number of estimates
+  \param stride spacing of the estimates in d
+  \param work scratch space reused between calls (see PMStatsWorkspace)
+  */
+void ComputePMStats(const ParticleMotionEllipse *d, int nd, int stride,
+        ParticleMotionEllipse& avg, ParticleMotionError& err,
+        double confidence_level, int number_of_trials, CounterRNG& rng,
+        const PMTimeSeriesControl& control, PMStatsWorkspace& work);
+/*! \brief ComputePMStats for many samples with a shared resample plan.
+
+  Computes the same results as ComputePMStats for each of a block of 
+  samples using the resample plan held by plan (see 
+  MultiStatisticBootstrap::plan) for all of them.   
+
+  \param d wavelet estimates.  Sample s has nw estimates d[s*nw] to 
+    d[s*nw+nw-1].
+  \param nw number of estimates per sample.  Must match the plan.
+  \param avg is set to the average ellipse of each sample 
+  \param err is set to the error estimates of each sample
+  \param confidence_level confidence level for the errors
+  \param plan holds the resample plan.  It is also used as work space.
+  */
+void ComputePMStatsPlanned(vector<ParticleMotionEllipse>& d, int nw,
+        vector<ParticleMotionEllipse>& avg, vector<ParticleMotionError>& err,
+        double confidence_level, MultiStatisticBootstrap& plan);
+/* Private state of PMTimeSeries used when error estimation is deferred 
+   (PMTimeSeriesControl::lazy_errors).   The nw wavelet ellipse 
+   estimates of each sample are stored in single precision columns 
+   with the layout of PMColumns.  Estimate iw of sample i is element 
+   nw*i+iw.  The bootstrap always uses estimates rounded to single 
+   precision so deferred results match those computed at construction
+   exactly.  pending[i] is true if the errors for sample i have not
+   been computed yet.  work is reused by every evaluation.  first is 
+   the number of samples dropped from the front by append.  Sample i
+   is sample first+i of the series as constructed and that number 
+   keys its random stream so dropping samples does not change the 
+   results for the rest.*/
+class PMDeferredErrors
+{
+public:
+    vector<float> major[3];
+    vector<float> minor[3];
+    vector<float> majornrm,minornrm;
+    vector<bool> pending;
+    int nw;
+    int npending;
+    int first;
+    double confidence;
+    int ntrials;
+    PMTimeSeriesControl control;
+    PMStatsWorkspace work;
+    PMDeferredErrors(){nw=0;npending=0;first=0;confidence=0.0;ntrials=0;};
+    /* Size the estimate columns to n estimates */
+    void resize(int n);
+    /* Store/return estimate i.  No range checking. */
+    void set(int i, const ParticleMotionEllipse& e);
+    ParticleMotionEllipse get(int i) const;
+    /* Drop the first n estimates */
+    void erase_front(int n);
+};
 class PMTimeSeries : public BasicTimeSeries, public Metadata
 {
     public:
@@ -54,11 +475,17 @@ class PMTimeSeries : public BasicTimeSeries, public Metadata
           \param bsmultiplier defines the number of trials to use in
              computing bootstrap errors 
              (number of trails=bsmultiplier*number_of_wavelets). 
+          \param control sets optional algorithm choices (see 
+             PMTimeSeriesControl).  Set output_stride to reduce the 
+             output sampling.  The stride used and the number of 
+             bootstrap estimates skipped are posted to Metadata with
+             keys output_stride and bootstrap_estimates_saved.
 
           \exception SeisppError can be thrown for several illegal
              conditions. */
         PMTimeSeries(MWTBundle& d, int band, 
-            double confidence=0.95,int bsmultiplier=100);
+            double confidence=0.95,int bsmultiplier=100,
+            const PMTimeSeriesControl& control=PMTimeSeriesControl());
         /*! Construct for a specified band with time average.
 
           This will compute particle motions with a dual averaging
@@ -85,11 +512,15 @@ class PMTimeSeries : public BasicTimeSeries, public Metadata
           \param bsmultiplier defines the number of trials to use in
              computing bootstrap errors 
              (number of trails=bsmultiplier*number_of_wavelets). 
+          \param control sets optional algorithm choices (see 
+             PMTimeSeriesControl).  Set incremental_covariance true 
+             to remove the quadratic scaling with averaging length. 
 
           \exception SeisppError can be thrown for several illegal
              conditions. */
         PMTimeSeries(MWTBundle& d, int band,int timesteps, int avlen,
-            double confidence=0.95,int bsmultiplier=100);
+            double confidence=0.95,int bsmultiplier=100,
+            const PMTimeSeriesControl& control=PMTimeSeriesControl());
         /*! Standard copy constructor. */
         PMTimeSeries(const PMTimeSeries& parent);
         /*! \brief Return the ellipse by sample number.
@@ -99,10 +530,21 @@ class PMTimeSeries : public BasicTimeSeries, public Metadata
         a regular grid in time.   This method returns the ellipse
         by a time series type index.
 
+        Data are stored in columns (see PMColumns) so the return is 
+        a copy gathered from the columns.  Use set_ellipse to change
+        sample i.
+
         \param i sample number to return.
         \exception Throws a SeisppError object if i is out of range. 
         */
-        ParticleMotionEllipse& ellipse(int i);
+        ParticleMotionEllipse ellipse(int i);
+        /*! \brief Replace the ellipse at sample number i.
+
+        \param i sample number to change.
+        \param e ellipse stored at sample i.
+        \exception Throws a SeisppError object if i is out of range. 
+        */
+        void set_ellipse(int i, const ParticleMotionEllipse& e);
         /*! \brief Return the error statistics by sample number.
 
           This object encapsulates the concept of time-variable
@@ -111,15 +553,92 @@ class PMTimeSeries : public BasicTimeSeries, public Metadata
         that contains all error estimates computed by the 
         multiwavelet tranform from a 3C seismogram.
 
+        If error estimation was deferred (see 
+        PMTimeSeriesControl::lazy_errors) the estimates for sample i
+        are computed on the first call and cached.
+
         \param i sample number to return.
         \exception Throws a SeisppError object if i is out of range. 
         */
         ParticleMotionError errors(int i);
+        /*! \brief Compute any deferred error estimates for a range of samples.
 
+          When PMTimeSeriesControl::lazy_errors was set in construction 
+          error estimates are only computed when requested.  This 
+          computes and caches them for samples i0 through i1-1.  
+          Ellipses are not changed.  It does nothing for samples 
+          already computed.  Use it before
+          reading the error columns through the columns method.
+          The range is silently clipped to the data range. */
+        void evaluate_errors(int i0, int i1);
+        /*! Compute all deferred error estimates. */
+        void evaluate_errors(){this->evaluate_errors(0,pmcols.size());};
+        /*! Return true if any error estimates are deferred. */
+        bool errors_deferred() const {return(deferred.npending>0);};
+        /*! \brief Append samples for later times.
 
-        /*! Get the raw vector of particle motion data defined as ellipses.*/
+          This is the interface for streaming (continuous data) 
+          processing where estimates are computed one block at a time.
+          Samples in d are added after the last sample of this object.
+          The cost is proportional to the number of samples appended. 
+
+          If this object is empty (ns=0) t0 is set to tstart.  Otherwise
+          tstart must be the time of the sample following the last 
+          sample (t0+ns*dt) within half a sample.   dt must be set 
+          before the first append.
+
+          \param d samples to be appended.
+          \param tstart time of the first sample of d.
+          \param horizon when positive samples older than this many
+            seconds before the last sample are dropped.  To keep the 
+            cost per sample constant they are dropped in blocks so 
+            the retained span is between horizon and about twice
+            horizon.  0 (default) keeps everything.
+          \exception SeisppError is thrown if dt is not set or tstart
+            does not match the end of the current data.
+          */
+        void append(const PMColumns& d, double tstart, double horizon=0.0);
+        /*! \brief Append a PMTimeSeries for later times.
+
+          Same as the PMColumns version but the time of the first 
+          sample is d.t0.  If this object is empty its Metadata 
+          (e.g. sta, evid, and band), time base, and band attributes 
+          are copied from d.  Otherwise the sample interval, band 
+          (f0, fw, and decfac), and averaging length of d must match
+          this object.  Any deferred error estimates in d are 
+          computed first.
+
+          \exception SeisppError is thrown for any mismatch or any
+            error thrown by the PMColumns version.
+          */
+        void append(PMTimeSeries& d, double horizon=0.0);
+
+
+        /*! \brief Read only access to the data without copying.
+
+          The ellipse and error data are stored as columns (see 
+          PMColumns).  This returns a const reference to that store.
+          It is the efficient way to scan attributes over the full 
+          time series (e.g. the maximum major axis length).  The 
+          reference is valid as long as this object exists and is not
+          modified.   Unlike ellipse and errors there is no range 
+          checking.  Use columns().size() for the number of samples
+          actually stored.  Deferred error estimates are not computed
+          by this method;  call evaluate_errors first if the error 
+          columns are needed or the ellipse columns must match 
+          results computed without deferral. */
+        const PMColumns& columns() const {return pmcols;};
+        /*! Get a copy of the particle motion data as a vector of ellipses.
+
+          This copies the entire data set.  Use columns() instead
+          when only read access is needed. */
         vector<ParticleMotionEllipse> get_pmdata();
-        /*! Ge the raw vector of error estimates for the ellipses. */
+        /*! Get a copy of the error estimates as a vector. 
+
+          Any deferred error estimates are computed first.
+
+          This copies the entire data set.  Use columns() instead
+          when only read access is needed. */
         vector<ParticleMotionError> get_pmerr();
         /*! \brief Get representation of major axis length as a time series.
 
@@ -204,6 +723,29 @@ class PMTimeSeries : public BasicTimeSeries, public Metadata
           copied to the TimeSeries that is returned.  
           */
         TimeSeries minor_inclination();
+        /*! \brief Compute several scalar metrics in one pass.
+
+          Each of the methods above that return a TimeSeries copies
+          the Metadata of this object and walks the full data set.  
+          This method computes any combination of them in a single 
+          pass over the data, writing into a matrix supplied by the 
+          caller.  The Metadata and time base of the result are those
+          of this object.
+
+          \param which lists the metrics wanted.  
+          \param result is the output.  It must be sized 
+            ns x which.size() before calling.  Column j is the metric 
+            which[j] (columns of a dmatrix are contiguous).
+          \exception SeisppError is thrown if result is not sized 
+            correctly. */
+        void metrics(const vector<PMMetric>& which, dmatrix& result);
+        /*! \brief Compute several scalar metrics as TimeSeries in one pass.
+
+          Same as the dmatrix version, but the results are returned as
+          TimeSeries objects in the same order as which.   The
+          TimeSeries shell (Metadata and time base) is built once and
+          copied for each output.  */
+        vector<TimeSeries> metrics(const vector<PMMetric>& which);
 
 
         /*! Zero any data defined by a gap. 
@@ -221,9 +763,18 @@ class PMTimeSeries : public BasicTimeSeries, public Metadata
           just dumps the contents in a readable form.
           */
         friend ostream& operator<<(ostream& os, PMTimeSeries& d);
+        /* The store (PMStore.h) reads and writes private attributes */
+        friend class PMStore;
+        friend class PMStoreWriter;
     private:
-        vector<ParticleMotionEllipse> pmdata;
-        vector<ParticleMotionError> pmerr;
+        /* All ellipse and error data are stored here */
+        PMColumns pmcols;
+        /* Used only when error estimation is deferred */
+        PMDeferredErrors deferred;
+        /* Bootstrap random stream coordinates (see CounterRNG) */
+        uint64_t rng_seed;
+        uint32_t rng_band,rng_source;
+        void set_random_streams(int band, const PMTimeSeriesControl& control);
         /* These attributes are stored here but should be 
            posted to Metadata to simplify interface. */
         int averaging_length;
@@ -234,14 +785,43 @@ class PMTimeSeries : public BasicTimeSeries, public Metadata
          * samples */
         double wavelet_duration;
         void post_attributes_to_metadata();
+        void post_edge_trim(MWTwaveform& x);
+        TimeSeries derived_time_series(string name);
+        void compute_statistics(vector<ParticleMotionEllipse>& pmw,
+                int nsamp, int nw, int sstride, int wstride, 
+                double confidence, int ntrials,
+                const PMTimeSeriesControl& control);
+        void planned_statistics(vector<ParticleMotionEllipse>& pmw,
+                const vector<int>& isamp, int nw, double confidence, 
+                int ntrials, int blocksize, int ifirst=0);
+        void fill_metrics(const vector<PMMetric>& which, double **out);
         friend class boost::serialization::access;
         template<class Archive>
                 void serialize(Archive & ar, const unsigned int version)
         {
+            /* Deferred error estimates are not saved.  They are
+             * computed before the object is written.  That changes 
+             * only the error columns (see lazy_errors) so the data 
+             * saved are the same as without deferral. */
+            if(Archive::is_saving::value && errors_deferred())
+                this->evaluate_errors();
             ar & boost::serialization::base_object<Metadata>(*this);
             ar & boost::serialization::base_object<BasicTimeSeries>(*this);
-            ar & pmdata;
-            ar & pmerr;
+            /* Version 2 changed the storage to columns.   Older
+             * files are converted when loaded. */
+            if(version>1)
+                ar & pmcols;
+            else
+            {
+                vector<ParticleMotionEllipse> pmdata;
+                vector<ParticleMotionError> pmerr;
+                ar & pmdata;
+                ar & pmerr;
+                pmcols=PMColumns();
+                pmcols.reserve(pmdata.size());
+                for(int i=0;i<pmdata.size();++i)
+                    pmcols.push_back(pmdata[i],pmerr[i]);
+            }
             ar & f0;
             ar & fw;
             ar & decfac;
@@ -253,6 +833,6 @@ class PMTimeSeries : public BasicTimeSeries, public Metadata
                 ar & wavelet_duration;
         };
 };
-BOOST_CLASS_VERSION(PMTimeSeries,1);
+BOOST_CLASS_VERSION(PMTimeSeries,2);
 double regularize_angle(double d,bool r=false);
 #endif
@@ -8,9 +8,6 @@ void dscal(int n, double a, double *x, int incx);
 double dnrm2(int n, double *x, int incx);
 void dcopy(int n,double *x, int incx, double *y, int incy);
 void daxpy(int n,double a,double *x, int incx, double *y, int incy);
-void cgesvd ( char jobu, char jobvt, int m, int n, 
-        FORTRAN_complex *ca, int lda, float *s, FORTRAN_complex *cu, int ldu, 
-        FORTRAN_complex *cvt, int ldvt, int *info );
 }
 /* Default constructor forces initialization to 0.0.   */
 
@@ -79,7 +76,7 @@ ParticleMotionEllipse::ParticleMotionEllipse(SEISPP::Complex x, SEISPP::Complex
         ry=abs(y);
         rz=abs(z);
         /* Necessary for testing to avoid nans */
-        if(rz<FLT_EPSILON && ry<FLT_EPSILON && rz<FLT_EPSILON )
+        if(rx<FLT_EPSILON && ry<FLT_EPSILON && rz<FLT_EPSILON )
         {
             this->zero();
             return;
@@ -132,23 +129,103 @@ ParticleMotionEllipse::ParticleMotionEllipse(SEISPP::Complex x, SEISPP::Complex
 	if(ddot(3,up,1,minor,1) < 0.0)
 		dscal(3,-1.0,minor,1);
 }
+/* Batched version of the constructor immediately above.  See 
+   ParticleMotionEllipse.h for the accuracy bound relative to the 
+   scalar formula.   The derivation is this.  Write x=rx*exp(i*thetax)
+   and similarly for y and z.   Then a+ib=x*x+y*y+z*z and 
+   phi1=-arg(a+ib)/2, so exp(i*phi1) is the principal square root 
+   of (a-ib)/|a+ib|.  The half angle formulas give cos(phi1) and 
+   sin(phi1) directly where the sign of sin(phi1) is the sign of -b
+   (copysign reproduces the atan2 convention for b=+-0).   Only one 
+   half angle formula is used in each case to avoid cancellation.   
+   The scalar code uses rx*cos(phi1+thetax)=Re(x*exp(i*phi1)) and 
+   rx*cos(phi2+thetax)=-Im(x*exp(i*phi1)) since phi2=phi1+pi/2.  
+
+   The loop body intentionally has no function calls other than sqrt
+   and copysign and uses conditional expressions in place of branches
+   so the compiler can vectorize it.  Note gcc will only do so 
+   with -fno-math-errno and -fno-trapping-math (set in Makefile2). */
+void ParticleMotionEllipseBatch(const int n, const double *xr, const double *xi,
+        const double *yr, const double *yi, const double *zr, const double *zi,
+        const double up[3], ParticleMotionEllipse *result)
+{
+    const double eps2(((double)FLT_EPSILON)*((double)FLT_EPSILON));
+    const double up0(up[0]),up1(up[1]),up2(up[2]);
+    for(int i=0;i<n;++i)
+    {
+        double x_r(xr[i]),x_i(xi[i]),y_r(yr[i]),y_i(yi[i]),z_r(zr[i]),z_i(zi[i]);
+        double ax2=x_r*x_r+x_i*x_i;
+        double ay2=y_r*y_r+y_i*y_i;
+        double az2=z_r*z_r+z_i*z_i;
+        /* Same zero test as scalar constructor done on squared moduli */
+        double live=((ax2<eps2) & (ay2<eps2) & (az2<eps2)) ? 0.0 : 1.0;
+        double a=(x_r*x_r-x_i*x_i)+(y_r*y_r-y_i*y_i)+(z_r*z_r-z_i*z_i);
+        double b=2.0*(x_r*x_i+y_r*y_i+z_r*z_i);
+        double smag=sqrt(a*a+b*b);
+        /* smag is 0 for circular motion where atan2(0,0)=0 in the 
+           scalar form.  c=1 reproduces that.  Denominators are 
+           guarded this way so every division is safe to evaluate
+           unconditionally. */
+        double sden=(smag>0.0) ? smag : 1.0;
+        double c=(smag>0.0) ? a/sden : 1.0;
+        double d=-b/sden;
+        /* Half angle formula applied only to the term without 
+           cancellation (h>=0.5 in both cases).  The other term 
+           comes from sin(2*phi1)=2*sin(phi1)*cos(phi1) */
+        bool cpos=(c>=0.0);
+        double h=cpos ? 0.5*(1.0+c) : 0.5*(1.0-c);
+        double root=sqrt(h);
+        double cosp=cpos ? root : d/(2.0*copysign(root,d));
+        double sinp=cpos ? d/(2.0*root) : copysign(root,d);
+        double x1[3],x2[3];
+        x1[0]=x_r*cosp-x_i*sinp;
+        x1[1]=y_r*cosp-y_i*sinp;
+        x1[2]=z_r*cosp-z_i*sinp;
+        x2[0]=-(x_r*sinp+x_i*cosp);
+        x2[1]=-(y_r*sinp+y_i*cosp);
+        x2[2]=-(z_r*sinp+z_i*cosp);
+        double nrmx1=sqrt(x1[0]*x1[0]+x1[1]*x1[1]+x1[2]*x1[2]);
+        double nrmx2=sqrt(x2[0]*x2[0]+x2[1]*x2[1]+x2[2]*x2[2]);
+        /* Same tie rule as scalar version: x2 is major unless x1 is 
+           strictly larger */
+        bool x1major=(nrmx1>nrmx2);
+        double majnrm=x1major ? nrmx1 : nrmx2;
+        double minnrm=x1major ? nrmx2 : nrmx1;
+        double scalemaj=(majnrm>0.0 ? live : 0.0)/(majnrm>0.0 ? majnrm : 1.0);
+        double scalemin=(minnrm>0.0 ? live : 0.0)/(minnrm>0.0 ? minnrm : 1.0);
+        double maj0=x1major ? x1[0] : x2[0];
+        double maj1=x1major ? x1[1] : x2[1];
+        double maj2=x1major ? x1[2] : x2[2];
+        double min0=x1major ? x2[0] : x1[0];
+        double min1=x1major ? x2[1] : x1[1];
+        double min2=x1major ? x2[2] : x1[2];
+        /* Choose the positive sign direction */
+        double dmaj=up0*maj0+up1*maj1+up2*maj2;
+        double dmin=up0*min0+up1*min1+up2*min2;
+        scalemaj=(dmaj<0.0) ? -scalemaj : scalemaj;
+        scalemin=(dmin<0.0) ? -scalemin : scalemin;
+        result[i].major[0]=maj0*scalemaj;
+        result[i].major[1]=maj1*scalemaj;
+        result[i].major[2]=maj2*scalemaj;
+        result[i].minor[0]=min0*scalemin;
+        result[i].minor[1]=min1*scalemin;
+        result[i].minor[2]=min2*scalemin;
+        result[i].majornrm=majnrm*live;
+        result[i].minornrm=minnrm*live;
+    }
+}
 ParticleMotionEllipse::ParticleMotionEllipse(ComplexTimeSeries& x, 
         ComplexTimeSeries& y, 
             ComplexTimeSeries& z,
                 TimeWindow w, double up[3])
 {
     try {
-        const string 
-            base_error("ParticleMotionEllipse(ComplexTimeSeries contructor):  ");
-        /* This is the work array used by cgesvd*/
-        FORTRAN_complex *A,*U,*Vt;  // U and Vt are not used but required args 
-        float svalues[3];
-        /* Extract the windows*/
-        ComplexTimeSeries xw=WindowData<ComplexTimeSeries>(x,w);
-        ComplexTimeSeries yw=WindowData<ComplexTimeSeries>(y,w);
-        ComplexTimeSeries zw=WindowData<ComplexTimeSeries>(z,w);
-        int ntw=xw.s.size();  // assume all the same length
-        int i,ia;
+        /* Views into the windows - no sample copies */
+        WindowView<ComplexTimeSeries,SEISPP::Complex> xw(x,w);
+        WindowView<ComplexTimeSeries,SEISPP::Complex> yw(y,w);
+        WindowView<ComplexTimeSeries,SEISPP::Complex> zw(z,w);
+        int ntw=xw.ns;  // assume all the same length
+        int i;
         /* Test for all zeros - required sometimes with synthetic data
          * tests.   Without this we get nans and all kind of nasty things.
          * As always tests against zero are a tad ambiguous.   with 
@@ -157,9 +234,9 @@ ParticleMotionEllipse::ParticleMotionEllipse(ComplexTimeSeries& x,
         bool zerotest(true);
         for(i=0;i<ntw;++i)
         {
-            if( (std::abs(xw.s[i])>FLT_EPSILON) 
-                    || (std::abs(yw.s[i])>FLT_EPSILON)
-                    || (std::abs(zw.s[i])>FLT_EPSILON) )
+            if( (std::abs(xw[i])>FLT_EPSILON) 
+                    || (std::abs(yw[i])>FLT_EPSILON)
+                    || (std::abs(zw[i])>FLT_EPSILON) )
             {
                 zerotest=false;
                 break;
@@ -170,51 +247,39 @@ ParticleMotionEllipse::ParticleMotionEllipse(ComplexTimeSeries& x,
             (*this) = ParticleMotionEllipse();
             return;
         }
-        A = (FORTRAN_complex *)calloc(3*ntw,sizeof(FORTRAN_complex));
-        if(A==NULL) throw SeisppError(base_error
-                + "calloc failed for principal component work matrix");
-        /* Load A in fortran complex order and call the lapack svd routine*/
-        for(i=0,ia=0;i<ntw;++i,ia+=3)
-        {
-            A[ia].r=(float)xw.s[i].real();
-            A[ia].i=(float)xw.s[i].imag();
-            A[ia+1].r=(float)yw.s[i].real();
-            A[ia+1].i=(float)yw.s[i].imag();
-            A[ia+2].r=(float)zw.s[i].real();
-            A[ia+2].i=(float)zw.s[i].imag();
-        }
-        int info;
-        cgesvd('o','n',3,ntw,A,3,svalues,U,3,Vt,3,&info);
-        if(info!=0) 
-        {
-            free(A);
-            throw SeisppError(base_error
-                + "cgesvd returned an error");
-        }
-        /* We now use the first column of A that is overwritten
-           with the singular vector linked to the largest singular
-           value.  We scale the complex numbers by the singular
-           value to get the amplitude */
-        SEISPP::Complex xz,yz,zz;
-        xz=SEISPP::Complex(A[0].r,A[0].i);
-        yz=SEISPP::Complex(A[1].r,A[1].i);
-        zz=SEISPP::Complex(A[2].r,A[2].i);
-        xz*=svalues[0];
-        yz*=svalues[0];
-        zz*=svalues[0];
-        /* This is very inefficient, but a simple way to build the 
-           ellipse from the singular vector */
-        ParticleMotionEllipse pmtmp(xz,yz,zz,up);
-        for(i=0;i<3;++i)
-        {
-            this->major[i]=pmtmp.major[i];
-            this->minor[i]=pmtmp.minor[i];
-        }
-        this->majornrm=pmtmp.majornrm;
-        this->minornrm=pmtmp.minornrm;
-        free(A);
+        /* This once called cgesvd on the 3 x ntw data matrix.  The 
+           leading left singular vector is the dominant eigenvector 
+           of the 3x3 matrix A*A^H so we form that instead and use 
+           the closed form solver through the PMCovariance constructor.
+           That eliminates the work array and the lapack call. */
+        PMCovariance cov;
+        for(i=0;i<ntw;++i) cov.add(xw[i],yw[i],zw[i]);
+        (*this)=ParticleMotionEllipse(cov,up);
     }catch(...){throw;};
 }
+ParticleMotionEllipse::ParticleMotionEllipse(PMCovariance& cov, double up[3])
+{
+    /* Equivalent of the all zero test used in the windowed constructor.
+       If any sample exceeded FLT_EPSILON the trace will too. */
+    if(cov.trace()<(FLT_EPSILON*FLT_EPSILON))
+    {
+        this->zero();
+        return;
+    }
+    /* Diagonals can be driven slightly negative by roundoff in a 
+       running sum so we clip them at 0. */
+    PMCovariance c(cov);
+    if(c.c00<0.0) c.c00=0.0;
+    if(c.c11<0.0) c.c11=0.0;
+    if(c.c22<0.0) c.c22=0.0;
+    SEISPP::Complex v[3];
+    double lambda=dominant_eigenpair(c,v);
+    double sv=lambda>0.0 ? sqrt(lambda) : 0.0;
+    v[0]*=sv;
+    v[1]*=sv;
+    v[2]*=sv;
+    (*this)=ParticleMotionEllipse(v[0],v[1],v[2],up);
+}
 /* Copy constructor */
 ParticleMotionEllipse::ParticleMotionEllipse(const ParticleMotionEllipse& parent)
 {
@@ -9,6 +9,78 @@
 #include "MWTransform.h"
 
 using namespace SEISPP;
+/*! \brief Running sum form of a 3x3 Hermitian covariance matrix.
+
+  The windowed ParticleMotionEllipse constructor finds the principal
+  component of a 3 x n complex matrix A whose columns are the (x,y,z)
+  transform samples in a time window.  The leading left singular 
+  vector of A is the dominant eigenvector of A*A^H.   This object 
+  holds that 3x3 matrix as a sum over samples so that a sliding 
+  window can be updated by adding entering samples and removing 
+  leaving ones.   Only the upper triangle is stored.  Sums are kept 
+  in double precision.
+  */
+class PMCovariance
+{
+public:
+    /*! Diagonal elements - sum of |x|^2, |y|^2, and |z|^2 */
+    double c00,c11,c22;
+    /*! Upper triangle - sums of x*conj(y), x*conj(z), and y*conj(z) */
+    SEISPP::Complex c01,c02,c12;
+    /*! Number of samples in the current sum */
+    int nsum;
+    /*! Default constructor - initializes to zero. */
+    PMCovariance(){this->zero();};
+    /*! Initialize all sums to zero. */
+    void zero()
+    {
+        c00=0.0; c11=0.0; c22=0.0;
+        c01=SEISPP::Complex(0.0,0.0);
+        c02=c01;
+        c12=c01;
+        nsum=0;
+    };
+    /*! Add one sample (one column of A) to the sum. */
+    void add(const SEISPP::Complex& x, const SEISPP::Complex& y, 
+            const SEISPP::Complex& z)
+    {
+        c00+=std::norm(x);  c11+=std::norm(y);  c22+=std::norm(z);
+        c01+=x*std::conj(y);
+        c02+=x*std::conj(z);
+        c12+=y*std::conj(z);
+        ++nsum;
+    };
+    /*! Remove one sample previously added to the sum. */
+    void remove(const SEISPP::Complex& x, const SEISPP::Complex& y, 
+            const SEISPP::Complex& z)
+    {
+        c00-=std::norm(x);  c11-=std::norm(y);  c22-=std::norm(z);
+        c01-=x*std::conj(y);
+        c02-=x*std::conj(z);
+        c12-=y*std::conj(z);
+        --nsum;
+    };
+    /*! Return the trace = sum of squared moduli of all samples. */
+    double trace(){return(c00+c11+c22);};
+};
+/*! \brief Closed form dominant eigenpair of a PMCovariance matrix.
+
+  Particle motion ellipses computed by the principal component method
+  need only the largest eigenvalue and its eigenvector of a 3x3 
+  Hermitian matrix.   This procedure computes them without LAPACK
+  and without any heap allocation.  The eigenvalue is found from the
+  trigonometric solution of the characteristic cubic and the 
+  eigenvector from cross products of rows of A-lambda*I, with 
+  fallbacks when the dominant eigenvalue is repeated.   One power 
+  iteration step and a Rayleigh quotient polish the result.
+  All arithmetic is double precision.
+
+  \param cov matrix to be analyzed (upper triangle as stored in 
+    PMCovariance).  Assumed positive semidefinite.
+  \param v is filled with the unit norm eigenvector (phase arbitrary).
+  \return dominant eigenvalue 
+  */
+double dominant_eigenpair(PMCovariance& cov, SEISPP::Complex v[3]);
 /*! \brief Particle motion ellipse computed by Multiwavelet method.
 
   The multiwavelet method allows the computation of particle motion ellipses
@@ -71,6 +143,23 @@ public:
        direction where the dot product with the up vector is positive.  
        */
     ParticleMotionEllipse(SEISPP::Complex x,SEISPP::Complex y,SEISPP::Complex z,double up[3]);
+    /*! \brief Construct from a window covariance matrix.
+
+      This produces the same ellipse as the windowed (time averaging) 
+      constructor, but the input is the 3x3 matrix A*A^H accumulated
+      in a PMCovariance object instead of the data window itself.  
+      The dominant eigenvector scaled by the square root of its 
+      eigenvalue is equivalent to the leading singular vector scaled
+      by the leading singular value.   That is used to define the 
+      ellipse with the complex number constructor.
+
+      The eigenvector is computed in closed form by the procedure
+      dominant_eigenpair.
+
+      \param cov covariance sums for the window
+      \param up defines sign convention as in other constructors.
+      */
+    ParticleMotionEllipse(PMCovariance& cov, double up[3]);
     /*! \brief Construct from major and minor axis vectors.
 
       A particle motion ellipse is uniquely defined by its pricipal 
@@ -117,5 +206,45 @@ private:
         ar & minor;
     };
 };
+/*! \brief Batched, trig free version of the complex number constructor.
+
+  The sample by sample PMTimeSeries constructor builds one ellipse per
+  wavelet per sample.   This procedure computes n ellipses in one pass
+  from structure of arrays inputs using an algebraically equivalent 
+  form of the formula used in the constructor
+  ParticleMotionEllipse(Complex x, Complex y, Complex z, up).
+  The sum a+ib in that constructor is x*x+y*y+z*z and the phase
+  rotation exp(i*phi1) is a square root of the normalized conjugate
+  of that sum.   That eliminates all atan2, sin, and cos calls 
+  and the BLAS calls on 3 vectors leaving a loop of simple arithmetic 
+  the compiler can vectorize.
+
+  Accuracy:  both formulas are backward stable and have comparable 
+  error.   Let cond=(|x|^2+|y|^2+|z|^2)/|x*x+y*y+z*z|.  cond is 1 for
+  linear motion and grows without bound as the motion approaches 
+  circular where the orientation of the axes in the plane of motion
+  is ill conditioned for any formula.   Against the scalar constructor
+  differences in majornrm and minornrm are bounded by 
+  1e-15*cond*majornrm, differences in major axis components by 
+  1e-15*cond, and differences in minor axis components by 
+  1e-15*cond*majornrm/minornrm (tested on 2e5 random triplets).   The
+  one intentional difference is exactly linear motion (minornrm=0) 
+  where the minor axis is returned as a zero vector instead of a 
+  direction set by roundoff.
+
+  \param n number of ellipses to compute
+  \param xr real part of x1 component (normally +east) - length n
+  \param xi imaginary part of x1 component - length n
+  \param yr real part of x2 component (normally +north) - length n
+  \param yi imaginary part of x2 component - length n
+  \param zr real part of x3 component (normally +up) - length n
+  \param zi imaginary part of x3 component - length n
+  \param up defines the sign convention for the axis vectors as in
+     the scalar constructor.
+  \param result is an array of length n where results are stored.
+  */
+void ParticleMotionEllipseBatch(const int n, const double *xr, const double *xi,
+        const double *yr, const double *yi, const double *zr, const double *zi,
+        const double up[3], ParticleMotionEllipse *result);
 
 #endif
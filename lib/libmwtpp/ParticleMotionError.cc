@@ -12,6 +12,8 @@ void ParticleMotionError::zero()
     ndgf_rect=0;
     ndgf_major_amp=0;
     ndgf_minor_amp=0;
+    estimated=false;
+    ntrials=0;
 }
 ParticleMotionError::ParticleMotionError()
 {
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
+#include <boost/serialization/version.hpp>
 using namespace std;
 /* \brief Data object to hold multiwavelet generated error estimates.
 
@@ -40,9 +41,24 @@ public:
     int ndgf_major_amp; 
     /*! Number of degrees of freedom of minor axis amplitude estimate. */
     int ndgf_minor_amp;
+    /*! \brief True if the error estimates were actually computed.
+
+      Estimation can be skipped for some samples (e.g. amplitude 
+      gating of the bootstrap in PMTimeSeries).   This is then false
+      and all other attributes are zero and should be ignored. 
+      Also false for all zero data where no estimate is possible. */
+    bool estimated;
+    /*! \brief Number of bootstrap trials used for these estimates.
+
+      Normally the number of trials requested, but fewer when the 
+      adaptive bootstrap converged early 
+      (see PMTimeSeriesControl::adaptive_bootstrap).   0 when 
+      estimated is false or when read from a file written before 
+      this attribute was added. */
+    int ntrials;
     /*! Defaault constructor.   
 
-      Initializes all data to zero. */
+      Initializes all data to zero and estimated to false. */
     ParticleMotionError();
     /*! Zero all attributes - convenience function. */
     void zero();
@@ -69,6 +85,17 @@ private:
         ar & ndgf_rect;
         ar & ndgf_major_amp;
         ar & ndgf_minor_amp;;
+        /* Errors in files written before this attribute was added
+           were always computed */
+        if(version>0)
+            ar & estimated;
+        else
+            estimated=true;
+        if(version>1)
+            ar & ntrials;
+        else
+            ntrials=0;
     };
 };
+BOOST_CLASS_VERSION(ParticleMotionError,2);
 #endif
@@ -2,10 +2,11 @@
 #include <tuple>
 #include <algorithm>
 #include <math.h>
+#include <sstream>
+#include <boost/math/distributions/normal.hpp>
 #include "perf.h"
 #include "SeisppError.h"
 #include "dmatrix.h"
-#include "VectorStatistics.h"
 #include "Vector3DBootstrapError.h"
 using namespace SEISPP;
 /* Important - through routine assumes x vectors are unit vectors.   Perhaps should verify this, but
@@ -20,95 +21,39 @@ Vector3DBootstrapError::Vector3DBootstrapError(dmatrix& x,
     throw SeisppError(base_error
         + "Illegal confidence interval requested - must be probability level (i.e greater than 0 and less than 1.0)");
   }
-  cl=confidence;
-  int nx=x.columns();
-  int i,j,k;
-  /* This is a large memory algorithm.  We load the trials into this matrix */
-  dmatrix trials(3,number_trials);
-  int col;
-  double *swrk=new double[nx];
-  //DEBUG
-  //cout << "Computing trials matrix"<<endl;
-  for(i=0;i<number_trials;++i)
-  {
-    dmatrix resampled(3,nx);
-    for(j=0;j<nx;++j)
-    {
-      col=random_array_index(nx);
-      for(k=0;k<3;++k) resampled(k,j)=x(k,col);
-    }
-    for(k=0;k<3;++k)
-    {
-      dcopy(nx,resampled.get_address(k,0),3,swrk,1);
-      VectorStatistics<double> rstat(swrk,nx);
-      trials(k,i)=rstat.mean();
-    }
-  }
-  delete [] swrk;
-  /*  Now from the suite of resampled trail values we need to
-  compute the boostrap average and errors for angles expressed
-  as dot products.  First compute the average of averages */
-  vector<double> work;
-  work.reserve(number_trials);
-  /* This initialization might not be necessary*/
-  for(i=0;i<number_trials;++i) work.push_back(0.0);
-  double med[3];
-  double nrmmed(0.0);
-  //DEBUG
-  //cout << "Computing mean vector"<<endl;
-  for(k=0;k<3;++k)
-  {
-    dcopy(number_trials,trials.get_address(k,0),3,&(work[0]),1);
-    VectorStatistics<double> vswrk(work);
-    med[k]=vswrk.mean();
-    nrmmed += (med[k]*med[k]);
-  }
-  /* Normalize the average vector */
-  nrmmed=sqrt(nrmmed);
-  for(k=0;k<3;++k) med[k] /= nrmmed;
-  this->mean.clear();
-  for(k=0;k<3;++k) this->mean.push_back(med[k]);
-  /* Compute angles from average by dot product.  We reuse
-     work - no need to clear as the above loop ends that way*/
-  //DEBUG
-  //cout << "Computing array of dot products"<<endl;
-  for(i=0;i<number_trials;++i)
+  try{
+    MultiStatisticBootstrap work;
+    this->compute(x,confidence,number_trials,work);
+  }catch(...){throw;};
+}
+Vector3DBootstrapError::Vector3DBootstrapError(dmatrix& x,
+    const double confidence, const int number_trials,
+    MultiStatisticBootstrap& work)
+{
+  /* The error message is only built when needed - this constructor
+     must not touch the heap */
+  if((confidence>1.0) || (confidence<=0.0))
   {
-    double dotprod,theta_trial,nrmtrials;
-    nrmtrials=dnrm2(3,trials.get_address(0,i),1);
-    for(k=0,dotprod=0.0;k<3;++k)
-    {
-      dotprod += trials(k,i)*med[k];
-    }
-    dotprod /= nrmtrials;
-    /* When all samples are the same dotprod can get close to one 
-     * and roundoff can lead to NaNs here.   fabs trap fixes that */
-    if(fabs(dotprod)>=1.0)
-    {
-        //DEBUG - return when verified this was the problem seen that led to this change
-        /*
-        cerr << "Vector3DBootstrapError constructor found dotprod="<<dotprod<<" which is greater than 1"
-            <<endl<<"Setting angle error to 0.0"<<endl;
-            */
-        theta_trial=0.0;
-    }
-    else
-    {
-        theta_trial=acos(dotprod);
-    }
-    work[i]=theta_trial;
+    throw SeisppError(string("Vector3DBootstrapError constructor:  ")
+        + "Illegal confidence interval requested - must be probability level (i.e greater than 0 and less than 1.0)");
   }
-  sort(work.begin(),work.end());
+  try{
+    this->compute(x,confidence,number_trials,work);
+  }catch(...){throw;};
+}
+/* Common code for both constructors.  The trial means are accumulated
+   directly from the columns of x so there are no temporaries. */
+void Vector3DBootstrapError::compute(dmatrix& x, double confidence,
+    int number_trials, MultiStatisticBootstrap& work)
+{
+  cl=confidence;
+  work.run_columns(x.columns(),x.get_address(0,0),confidence,number_trials);
+  const double *med=work.mean_vector(0);
+  for(int k=0;k<3;++k) mean[k]=med[k];
   /* This angle error is one sided - we estimate the probability
      the uncertainty in theta angles is less than the
      confidence value */
-  int nconf=rint(((double)number_trials)*confidence);
-  //DEBUG
-  //cout << "Computed position for confidence="<<nconf<<" of "<<number_trials<<endl;
-  if(nconf==number_trials) nconf=number_trials-1;   // Silently handled for roundoff errors
-  if(nconf>=number_trials)
-    throw SeisppError(base_error + "Coding problem - computed position of confidence outside array bound");
-  aci=work[nconf];
+  aci=work.angle_error(0);
 }
 pair<double,double> bootstrap_mv(const vector<double>& x, const double ci, const double ntrials)
 {
@@ -120,45 +65,345 @@ pair<double,double> bootstrap_mv(const vector<double>& x, const double ci, const
       throw SeisppError(base_error
           + "Illegal confidence interval requested - must be probability level (i.e greater than 0 and less than 1.0)");
     }
-    vector<double> trials;
-    trials.reserve(ntrials);
-    int nx=x.size();
-    double *work=new double[nx];
-    int i,j;
-    for(j=0;j<ntrials;++j)
+    /* Computed with the weight formulation in MultiStatisticBootstrap.
+       Result is the median of the trial means and half the range
+       between the confidence limits. */
+    MultiStatisticBootstrap bs;
+    bs.run(x.size(),1,&(x[0]),0,NULL,ci,(int)ntrials);
+    pair<double,double> result;
+    result.first=bs.center(0);
+    result.second=bs.halfrange(0);
+    return result;
+  }catch(...){throw;};
+}
+MultiStatisticBootstrap::MultiStatisticBootstrap()
+{
+  ldt=0;
+  nused=0;
+  nxplan=0;
+  pscalars=0;
+  pvectors=0;
+  pconfidence=0.0;
+}
+/* Sanity checks and sizing of work space shared by all run methods.
+   ntrials is the maximum number of trials that will be run. */
+void MultiStatisticBootstrap::size_work(int nx, int nscalars, int nvectors,
+        double confidence, int ntrials)
+{
+  /* Error messages are built only when thrown so a reused object does
+     no heap allocation */
+  if((confidence>1.0) || (confidence<=0.0))
+    throw SeisppError(string("MultiStatisticBootstrap::run:  ")
+        + "Illegal confidence interval requested - must be probability level (i.e greater than 0 and less than 1.0)");
+  if((nx<=0) || (ntrials<=0))
+    throw SeisppError(string("MultiStatisticBootstrap::run:  ")
+        + "number of observations and number of trials must be positive");
+  int nq=nscalars+3*nvectors;
+  ldt=ntrials;
+  nused=0;
+  /* Any plan is replaced by the resamples of this run */
+  nxplan=0;
+  /* resize does nothing if the object was already used for this size */
+  index.resize(nx);
+  counts.assign(ldt*nx,0.0);
+  trials.resize(nq*ldt);
+  work.resize(ldt);
+  scenter.resize(nscalars);
+  shalfrange.resize(nscalars);
+  vmean.resize(3*nvectors);
+  vangle.resize(nvectors);
+}
+/* Draws resamples for trials t0 to t1-1 into the count matrix.  rng
+   NULL means use random_array_indices. */
+void MultiStatisticBootstrap::draw(int nx, int t0, int t1, CounterRNG *rng)
+{
+  for(int t=t0;t<t1;++t)
+  {
+    if(rng==NULL)
+      random_array_indices(nx,nx,&(index[0]));
+    else
+      rng->fill_indices(nx,nx,&(index[0]));
+    for(int j=0;j<nx;++j) counts[index[j]*ldt+t]+=1.0;
+  }
+}
+/* Trial means for trials t0 to t1-1 of each quantity are rows t0 to
+   t1-1 of W x / nx.  Vector component q (3*v+k) of observation i is
+   vectors[q*vcomp+i*vobs]. */
+void MultiStatisticBootstrap::trial_means(int nx, int nscalars,
+        const double *scalars, int nvectors, const double *vectors,
+        int vcomp, int vobs, int t0, int t1)
+{
+  double scale=1.0/((double)nx);
+  for(int q=0;q<nscalars;++q)
+    dgemv('N',t1-t0,nx,scale,&(counts[t0]),ldt,
+        const_cast<double *>(scalars+q*nx),1,0.0,&(trials[q*ldt+t0]),1);
+  for(int q=0;q<3*nvectors;++q)
+    dgemv('N',t1-t0,nx,scale,&(counts[t0]),ldt,
+        const_cast<double *>(vectors+q*vcomp),vobs,0.0,
+        &(trials[(nscalars+q)*ldt+t0]),1);
+}
+void MultiStatisticBootstrap::run(int nx, int nscalars, const double *scalars,
+        int nvectors, const double *vectors, double confidence, int ntrials)
+{
+  this->size_work(nx,nscalars,nvectors,confidence,ntrials);
+  this->draw(nx,0,ntrials,NULL);
+  this->trial_means(nx,nscalars,scalars,nvectors,vectors,nx,1,0,ntrials);
+  this->evaluate(nscalars,nvectors,confidence,ntrials,0);
+}
+void MultiStatisticBootstrap::run(int nx, int nscalars, const double *scalars,
+        int nvectors, const double *vectors, double confidence, int ntrials,
+        CounterRNG& rng)
+{
+  this->size_work(nx,nscalars,nvectors,confidence,ntrials);
+  this->draw(nx,0,ntrials,&rng);
+  this->trial_means(nx,nscalars,scalars,nvectors,vectors,nx,1,0,ntrials);
+  this->evaluate(nscalars,nvectors,confidence,ntrials,0);
+}
+void MultiStatisticBootstrap::run_columns(int nx, const double *x,
+        double confidence, int ntrials)
+{
+  this->size_work(nx,0,1,confidence,ntrials);
+  this->draw(nx,0,ntrials,NULL);
+  this->trial_means(nx,0,NULL,1,x,1,3,0,ntrials);
+  this->evaluate(0,1,confidence,ntrials,0);
+}
+/* Returns true if every confidence interval estimate changed by less 
+   than tolerance relative to its current value */
+static bool intervals_converged(const vector<double>& previous,
+        const vector<double>& current, double tolerance)
+{
+  for(int i=0;i<current.size();++i)
+    if(fabs(current[i]-previous[i])>tolerance*fabs(current[i]))
+      return false;
+  return true;
+}
+void MultiStatisticBootstrap::run_adaptive(int nx, int nscalars,
+        const double *scalars, int nvectors, const double *vectors,
+        double confidence, int batch_size, int maxtrials, double tolerance,
+        CounterRNG& rng)
+{
+  const string base_error("MultiStatisticBootstrap::run_adaptive:  ");
+  if(batch_size<=0)
+    throw SeisppError(base_error + "batch size must be positive");
+  this->size_work(nx,nscalars,nvectors,confidence,maxtrials);
+  int n(0);
+  do {
+    int n1=n+batch_size;
+    if(n1>maxtrials) n1=maxtrials;
+    this->draw(nx,n,n1,&rng);
+    this->trial_means(nx,nscalars,scalars,nvectors,vectors,nx,1,n,n1);
+    /* evaluate reorders work but trials is left intact so the 
+       statistics can be recomputed after each batch */
+    this->evaluate(nscalars,nvectors,confidence,n1,0);
+    current.assign(shalfrange.begin(),shalfrange.end());
+    current.insert(current.end(),vangle.begin(),vangle.end());
+    bool converged=((n>0) 
+            && intervals_converged(previous,current,tolerance));
+    n=n1;
+    if(converged) break;
+    previous.swap(current);
+  } while(n<maxtrials);
+}
+void MultiStatisticBootstrap::run_jackknife(int nx, int nscalars,
+        const double *scalars, int nvectors, const double *vectors,
+        double confidence)
+{
+  const string base_error("MultiStatisticBootstrap::run_jackknife:  ");
+  if((confidence>1.0) || (confidence<=0.0))
+    throw SeisppError(base_error
+        + "Illegal confidence interval requested - must be probability level (i.e greater than 0 and less than 1.0)");
+  if(nx<2)
+    throw SeisppError(base_error
+        + "jackknife requires at least two observations");
+  scenter.resize(nscalars);
+  shalfrange.resize(nscalars);
+  vmean.resize(3*nvectors);
+  vangle.resize(nvectors);
+  nused=nx;
+  double n=(double)nx;
+  int i,k,q;
+  /* For a mean the delete-one jackknife variance reduces to the 
+     sample variance divided by n.  The interval is the normal 
+     interval with that standard error. */
+  boost::math::normal stdnormal;
+  /* The quantiles are infinite for a confidence of 1 */
+  double z(HUGE_VAL),rayleigh(HUGE_VAL);
+  if(confidence<1.0)
+  {
+    z=boost::math::quantile(stdnormal,(1.0+confidence)/2.0);
+    rayleigh=sqrt(-log(1.0-confidence));
+  }
+  for(q=0;q<nscalars;++q)
+  {
+    const double *x=scalars+q*nx;
+    double mean(0.0),ss(0.0);
+    for(i=0;i<nx;++i) mean+=x[i];
+    mean/=n;
+    for(i=0;i<nx;++i) ss+=(x[i]-mean)*(x[i]-mean);
+    scenter[q]=mean;
+    shalfrange[q]=(ss>0.0 ? z*sqrt(ss/(n*(n-1.0))) : 0.0);
+  }
+  /* For vectors the delete-one means are compared to the full mean 
+     direction.  The jackknife variance of the direction is 
+     (n-1)/n times the sum of squared angles.  The angle error is 
+     one sided (like the bootstrap) so it is the confidence level 
+     point of a Rayleigh distribution with that variance. */
+  for(q=0;q<nvectors;++q)
+  {
+    const double *v[3];
+    double sum[3],*med=&(vmean[3*q]);
+    double nrmmed(0.0);
+    for(k=0;k<3;++k)
+    {
+      v[k]=vectors+(3*q+k)*nx;
+      sum[k]=0.0;
+      for(i=0;i<nx;++i) sum[k]+=v[k][i];
+      nrmmed+=sum[k]*sum[k];
+    }
+    nrmmed=sqrt(nrmmed);
+    for(k=0;k<3;++k) med[k]=sum[k]/nrmmed;
+    double sstheta(0.0);
+    for(i=0;i<nx;++i)
     {
-      for(i=0;i<nx;++i)
+      double dotprod(0.0),nrmdel(0.0);
+      for(k=0;k<3;++k)
       {
-        int col;
-        col=random_array_index(nx);
-        work[i]=x[col];
+        double del=sum[k]-v[k][i];
+        dotprod+=del*med[k];
+        nrmdel+=del*del;
+      }
+      dotprod/=sqrt(nrmdel);
+      /* Same roundoff trap as Vector3DBootstrapError */
+      if(fabs(dotprod)<1.0)
+      {
+        double theta=acos(dotprod);
+        sstheta+=theta*theta;
       }
-      VectorStatistics<double> vswrk(work,nx);
-      trials.push_back(vswrk.mean());
     }
-    delete [] work;
-    sort(trials.begin(),trials.end());
-    //DEBUG
-    /*
-    cout << "Sorted bootstrap mean values"<<endl;
-    for(i=0;i<ntrials;++i) cout << trials[i]<<endl;
-    */
-    int ilow,ihigh,imed;
-    double ltail,htail;
-    ltail=(1.0-ci)/2.0;  //probability of smaller than lower cofidence limit
-    htail=ltail+ci;  //probability of larger outer confidence limit
-    ilow=rint( ( (double)ntrials)*ltail);
-    ihigh=rint( ( (double)ntrials)*htail);
-    //debug
-    /*
-    cout << "ltail, ilow, htail, ihigh"<<endl
-      << ltail <<" "<<ilow<<" "<<htail<<" "<<ihigh<<endl;
-    cout << trials[ihigh]<<" "<<trials[ilow]<<endl;
-    */
-    imed=ntrials/2;  // Assume ntrials is large enough to not worry abound odd/even
-    pair<double,double> result;
-    result.first=trials[imed];
-    result.second = (trials[ihigh]-trials[ilow])/2.0; // return half range aka sigma in normal distribibution
-    return result;
-  }catch(...){throw;};
+    vangle[q]=(sstheta>0.0 ? rayleigh*sqrt(sstheta*(n-1.0)/n) : 0.0);
+    if(vangle[q]>M_PI) vangle[q]=M_PI;
+  }
+}
+void MultiStatisticBootstrap::plan(int nx, int ntrials, CounterRNG& rng)
+{
+  if((nx<=0) || (ntrials<=0))
+    throw SeisppError(string("MultiStatisticBootstrap::plan:  ")
+        + "number of observations and number of trials must be positive");
+  ldt=ntrials;
+  nxplan=nx;
+  index.resize(nx);
+  counts.assign(ldt*nx,0.0);
+  this->draw(nx,0,ntrials,&rng);
+}
+void MultiStatisticBootstrap::run_planned(int nx, int nsamp, int nscalars,
+        const double *scalars, int nvectors, const double *vectors,
+        double confidence)
+{
+  const string base_error("MultiStatisticBootstrap::run_planned:  ");
+  if((nxplan<=0) || (nx!=nxplan))
+  {
+    stringstream ss;
+    ss << "Plan is for "<<nxplan<<" observations but data have "
+        <<nx<<endl<<"Call plan before run_planned"<<endl;
+    throw SeisppError(base_error+ss.str());
+  }
+  if((confidence>1.0) || (confidence<=0.0))
+    throw SeisppError(base_error
+        + "Illegal confidence interval requested - must be probability level (i.e greater than 0 and less than 1.0)");
+  if(nsamp<=0) return;
+  int nq=nscalars+3*nvectors;
+  trials.resize(nq*ldt*nsamp);
+  work.resize(ldt);
+  scenter.resize(nscalars);
+  shalfrange.resize(nscalars);
+  vmean.resize(3*nvectors);
+  vangle.resize(nvectors);
+  pscalars=nscalars;
+  pvectors=nvectors;
+  pconfidence=confidence;
+  /* Trial means of quantity q for all samples are one matrix product
+     (W times the nx by nsamp matrix of that quantity).   Sample s 
+     results go to trials[s*nq*ldt] in the same layout used by run. */
+  double scale=1.0/((double)nx);
+  int q;
+  for(q=0;q<nscalars;++q)
+    dgemm('N','N',ldt,nsamp,nx,scale,&(counts[0]),ldt,
+        const_cast<double *>(scalars+q*nx),nscalars*nx,0.0,
+        &(trials[q*ldt]),nq*ldt);
+  for(q=0;q<3*nvectors;++q)
+    dgemm('N','N',ldt,nsamp,nx,scale,&(counts[0]),ldt,
+        const_cast<double *>(vectors+q*nx),3*nvectors*nx,0.0,
+        &(trials[(nscalars+q)*ldt]),nq*ldt);
+}
+void MultiStatisticBootstrap::select(int s)
+{
+  int nq=pscalars+3*pvectors;
+  this->evaluate(pscalars,pvectors,pconfidence,ldt,s*nq*ldt);
+}
+/* Computes all the statistics from the trial means of the first ntrials
+   trials.  Trial means start at trials[toffset]. */
+void MultiStatisticBootstrap::evaluate(int nscalars, int nvectors,
+        double confidence, int ntrials, int toffset)
+{
+  int k,q,t;
+  nused=ntrials;
+  /* Quantile positions.  These match bootstrap_mv and 
+     Vector3DBootstrapError except positions are kept in range. */
+  double ltail=(1.0-confidence)/2.0;
+  double htail=ltail+confidence;
+  int ilow=rint(((double)ntrials)*ltail);
+  int ihigh=rint(((double)ntrials)*htail);
+  int imed=ntrials/2;
+  int nconf=rint(((double)ntrials)*confidence);
+  if(ihigh>=ntrials) ihigh=ntrials-1;
+  if(nconf>=ntrials) nconf=ntrials-1;
+  vector<double>::iterator wb=work.begin();
+  for(q=0;q<nscalars;++q)
+  {
+    copy(trials.begin()+toffset+q*ldt,
+        trials.begin()+toffset+q*ldt+ntrials,wb);
+    /* Each selection leaves larger values after the position found
+       so the next (larger) position only has to search that part */
+    vector<double>::iterator we=wb+ntrials;
+    nth_element(wb,wb+ilow,we);
+    if(imed>ilow)
+      nth_element(wb+ilow+1,wb+imed,we);
+    if(ihigh>imed)
+      nth_element(wb+imed+1,wb+ihigh,we);
+    scenter[q]=work[imed];
+    shalfrange[q]=(work[ihigh]-work[ilow])/2.0;
+  }
+  for(q=0;q<nvectors;++q)
+  {
+    const double *tv[3];
+    double *med=&(vmean[3*q]);
+    double nrmmed(0.0);
+    for(k=0;k<3;++k)
+    {
+      tv[k]=&(trials[toffset+(nscalars+3*q+k)*ldt]);
+      double sum(0.0);
+      for(t=0;t<ntrials;++t) sum+=tv[k][t];
+      med[k]=sum/((double)ntrials);
+      nrmmed+=med[k]*med[k];
+    }
+    nrmmed=sqrt(nrmmed);
+    for(k=0;k<3;++k) med[k]/=nrmmed;
+    for(t=0;t<ntrials;++t)
+    {
+      double dotprod(0.0),nrmtrial(0.0);
+      for(k=0;k<3;++k)
+      {
+        dotprod+=tv[k][t]*med[k];
+        nrmtrial+=tv[k][t]*tv[k][t];
+      }
+      dotprod/=sqrt(nrmtrial);
+      /* Same roundoff trap as Vector3DBootstrapError */
+      if(fabs(dotprod)>=1.0)
+        work[t]=0.0;
+      else
+        work[t]=acos(dotprod);
+    }
+    nth_element(wb,wb+nconf,wb+ntrials);
+    vangle[q]=work[nconf];
+  }
 }
@@ -2,6 +2,8 @@
 #define _VECTOR3DBOOTSTRAPERROR_H_
 #include <vector>
 #include "dmatrix.h"
+#include "CounterRNG.h"
+class MultiStatisticBootstrap;
 /* This is a specialized implementation of the bootstrap to compute confidence intervals
    for angle deviations computed by dot products of suite of multiwavelet particle motion estimates.
 
@@ -25,9 +27,21 @@ class Vector3DBootstrapError
     \number_trials - number of resampling trials for the bootstrap.
     */
     Vector3DBootstrapError(dmatrix& x, const double confidence, const int number_trials);
+    /*! \brief Construct using caller supplied work space.
+
+    Same as the primary constructor but all work space is held by 
+    work.  When the same work object is reused for data of the same
+    size (the normal case of one call per time sample) nothing is 
+    allocated on the heap.   Results are identical to the primary 
+    constructor.
+
+    \param work scratch space.  Contents on entry are ignored.
+    */
+    Vector3DBootstrapError(dmatrix& x, const double confidence, 
+        const int number_trials, MultiStatisticBootstrap& work);
     vector<double> mean_vector()
     {
-      return mean;
+      return vector<double>(mean,mean+3);
     };
     double angle_error()
     {
@@ -39,14 +53,193 @@ class Vector3DBootstrapError
     };
   private:
     /*! bootstrap median of 3D vectors */
-    vector<double>  mean;
+    double mean[3];
     /* Estimated confidence interval.*/
     double aci;
     /* input confidence level */
     double cl;
+    void compute(dmatrix& x, double confidence, int number_trials,
+        MultiStatisticBootstrap& work);
 };
 /*! Generate random integers between 0 and nrange-1 */
 int random_array_index(int range);
+/*! Fill out with n random integers between 0 and range-1. */
+void random_array_indices(int range, int n, int *out);
+/*! \brief Bootstrap several statistics from one set of resamples.
+
+  bootstrap_mv and Vector3DBootstrapError each draw their own 
+  resamples.  When several statistics are computed from the same 
+  observations that multiplies the cost of the random number draws 
+  and of the passes through the data.  This object draws one set of
+  resamples and computes the trial means of every quantity from it.
+
+  Every statistic bootstrapped here is a mean, so a resample is
+  represented by its weights:  the number of times each observation
+  was drawn.  The weights form an ntrials by nx count matrix W (each
+  row is a multinomial sample with nx draws) and the trial means of 
+  quantity x are the matrix-vector product W x / nx computed with 
+  dgemv.  That replaces the gather loop of the original algorithm, 
+  which can not be vectorized, with a BLAS kernel.  W is built from
+  the same random draws the gather used so results are the same as 
+  the original apart from roundoff.
+
+  Data are scalars (one value per observation) and 3D unit vectors.
+  Results for scalars are the same as bootstrap_mv and results for 
+  vectors are the same as Vector3DBootstrapError.   Quantiles are 
+  found by selection (nth_element) instead of a full sort.  All 
+  work space is held by the object so none is allocated per trial 
+  and an object reused for data of the same size allocates nothing.
+  */
+class MultiStatisticBootstrap
+{
+public:
+    MultiStatisticBootstrap();
+    /*! \brief Run the bootstrap.
+
+      \param nx number of observations
+      \param nscalars number of scalar quantities
+      \param scalars scalar data.  Value of scalar s for observation
+        i is scalars[s*nx+i].
+      \param nvectors number of vector quantities
+      \param vectors vector data.  Component k of vector v for 
+        observation i is vectors[(3*v+k)*nx+i].
+      \param confidence confidence level (0<confidence<1)
+      \param ntrials number of bootstrap trials
+      \exception SeisppError is thrown for an invalid confidence level
+        or if nx or ntrials is not positive.
+      */
+    void run(int nx, int nscalars, const double *scalars,
+            int nvectors, const double *vectors,
+            double confidence, int ntrials);
+    /*! \brief Run the bootstrap with resamples drawn from rng.
+
+      Same as the other run method but the resample indices are drawn
+      from rng instead of the shared generator used by 
+      random_array_index.   Results are then reproducible and this 
+      can be used from multiple threads (one object per thread). */
+    void run(int nx, int nscalars, const double *scalars,
+            int nvectors, const double *vectors,
+            double confidence, int ntrials, CounterRNG& rng);
+    /*! \brief Bootstrap one set of vectors stored as matrix columns.
+
+      Same as run with no scalars and one vector except the vectors 
+      are in the layout of a 3 x nx dmatrix:  component k of 
+      observation i is x[3*i+k].   Resample indices come from 
+      random_array_index.  Used by Vector3DBootstrapError. */
+    void run_columns(int nx, const double *x, double confidence,
+            int ntrials);
+    /*! \brief Run the bootstrap until the confidence intervals converge.
+
+      Trials are run in batches of batch_size drawn from rng.  After
+      each batch the statistics are recomputed from all trials run so
+      far.  Trials stop when every confidence interval (the halfrange
+      of each scalar and the angle error of each vector) changed by
+      less than tolerance times its current value since the previous
+      batch, or when maxtrials trials have been run.   Tightly
+      clustered data (e.g. highly rectilinear signals) typically
+      converge in a small fraction of maxtrials.  Use trials_used to
+      get the number of trials actually run.
+
+      \exception SeisppError is thrown for the same conditions as run
+        and if batch_size is not positive.
+      */
+    void run_adaptive(int nx, int nscalars, const double *scalars,
+            int nvectors, const double *vectors, double confidence,
+            int batch_size, int maxtrials, double tolerance,
+            CounterRNG& rng);
+    /*! \brief Compute the statistics with the delete-one jackknife.
+
+      A fast alternative to the bootstrap.  Only nx leave one out 
+      resamples are needed instead of hundreds of trials.  Results 
+      have the same meaning as the bootstrap results except center 
+      is the mean instead of the median of trial means.  Intervals 
+      assume the estimates are normally distributed:  halfrange is 
+      the normal interval computed from the jackknife standard error
+      and angle_error is the confidence level point of the Rayleigh 
+      distribution with the jackknife variance of the direction.
+      trials_used returns nx.  Confidence levels are checked as in 
+      run.  Those distributions are unbounded so a confidence of 1.0
+      gives a halfrange of HUGE_VAL and an angle_error of pi for any
+      statistic that is not constant.
+
+      \exception SeisppError is thrown for an invalid confidence level
+        or if nx is less than 2.
+      */
+    void run_jackknife(int nx, int nscalars, const double *scalars,
+            int nvectors, const double *vectors, double confidence);
+    /*! \brief Draw a resample plan to be shared by many data sets.
+
+      The bootstrap resamples (the count matrix) depend only on the 
+      number of observations and trials.  When many data sets have
+      the same number of observations one plan can be applied to all
+      of them with run_planned.  The plan stays valid until the next
+      call to plan or any run method.
+
+      \param nx number of observations
+      \param ntrials number of bootstrap trials
+      \param rng stream the resamples are drawn from
+      */
+    void plan(int nx, int ntrials, CounterRNG& rng);
+    /*! \brief Bootstrap a block of data sets with the current plan.
+
+      Data for sample s of the block are in the layout of run starting
+      at scalars[s*nscalars*nx] and vectors[s*3*nvectors*nx].  The
+      trial means of each quantity for all samples are computed as 
+      one matrix product (dgemm) of the count matrix with the data.
+      Results for each sample are then obtained with select.
+
+      \exception SeisppError is thrown if nx does not match the plan
+        or for an invalid confidence level.
+      */
+    void run_planned(int nx, int nsamp, int nscalars, const double *scalars,
+            int nvectors, const double *vectors, double confidence);
+    /*! \brief Load the results for sample s of the last run_planned.
+
+      After this call center, halfrange, mean_vector, and angle_error
+      return the results for sample s.  No range checking. */
+    void select(int s);
+    /*! Number of trials used to compute the current results.*/
+    int trials_used() const {return nused;};
+    /*! Median of trial means of scalar s (bootstrap_mv first).*/
+    double center(int s) const {return scenter[s];};
+    /*! Half width of the confidence interval of scalar s 
+      (bootstrap_mv second).*/
+    double halfrange(int s) const {return shalfrange[s];};
+    /*! Normalized mean of trial means of vector v.  Returns a pointer
+      to 3 values.*/
+    const double *mean_vector(int v) const {return &(vmean[3*v]);};
+    /*! One sided angle confidence interval (radians) of vector v.*/
+    double angle_error(int v) const {return vangle[v];};
+private:
+    /* Resample indices for one trial */
+    vector<int> index;
+    /* ldt x nx count matrix stored by columns where ldt is the maximum
+       number of trials.  The number of times observation j was drawn
+       in trial t is counts[j*ldt+t] */
+    vector<double> counts;
+    /* Trial means.  Quantity q (scalars first then vector components)
+       of trial t is trials[q*ldt+t] */
+    vector<double> trials;
+    int ldt;
+    int nused;
+    /* Intervals of the last two batches of the adaptive bootstrap */
+    vector<double> previous,current;
+    /* Number of observations of the current plan (0 if none) */
+    int nxplan;
+    /* Arguments of the last run_planned call needed by select */
+    int pscalars,pvectors;
+    double pconfidence;
+    vector<double> work;
+    vector<double> scenter,shalfrange,vmean,vangle;
+    void size_work(int nx, int nscalars, int nvectors, double confidence,
+            int ntrials);
+    void draw(int nx, int t0, int t1, CounterRNG *rng);
+    void trial_means(int nx, int nscalars, const double *scalars,
+            int nvectors, const double *vectors, int vcomp, int vobs,
+            int t0, int t1);
+    void evaluate(int nscalars, int nvectors, double confidence,
+            int ntrials, int toffset);
+};
 /* Simple procedure to estimate bootstrap mean and variance (the mv appendage)
 for a vector of input numbers x.   ci is confidence level and ntrials is
 number of trials.   Returns estiamte of center as first of pair and confidence
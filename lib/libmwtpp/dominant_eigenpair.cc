@@ -0,0 +1,172 @@
+#include <math.h>
+#include <cfloat>
+#include "ParticleMotionEllipse.h"
+/* Closed form solution for the largest eigenvalue and the associated
+   eigenvector of the 3x3 Hermitian matrix stored in a PMCovariance 
+   object.   This replaces the LAPACK calls (cgesvd on the data window
+   or cheev on the 3x3 matrix) previously used to compute particle 
+   motion ellipses by the principal component method.   For the 
+   small matrices involved the LAPACK call overhead and workspace 
+   handling dominated the cost.  Everything here is on the stack.
+
+   The algorithm is:
+   1.  The largest eigenvalue is found by the trigonometric solution of
+       the characteristic cubic of the shifted matrix K=A-mI where m 
+       is trace(A)/3.   
+   2.  The eigenvector is a null vector of A-lambda*I.  Rows r_i of 
+       that matrix satisfy r_i.v=0 (bilinear product - no conjugate) 
+       so v is the cross product of the pair of rows with the largest
+       cross product.   When the dominant eigenvalue is repeated all
+       the cross products vanish and any vector orthogonal to the 
+       largest nonzero row is an eigenvector.  If all rows vanish 
+       A is a multiple of I and any vector will do.
+   3.  One power iteration step is applied and the eigenvalue is 
+       recomputed as the Rayleigh quotient.   That makes the 
+       eigenvalue accurate to rounding error relative to the norm of
+       A even when the cubic solution loses digits.
+
+   The returned vector has unit L2 norm.  Its phase is arbitrary, as 
+   is that of a singular vector returned by cgesvd.  The particle motion
+   ellipse computed from it is independent of that phase. 
+
+   Returns the dominant eigenvalue (>=0 for a covariance matrix).
+
+   Author:  Written as part of the PMCovariance revision. 
+*/
+/* Bilinear cross product of complex 3 vectors a and b */
+static void ccross(const SEISPP::Complex *a, const SEISPP::Complex *b,
+        SEISPP::Complex *c)
+{
+    c[0]=a[1]*b[2]-a[2]*b[1];
+    c[1]=a[2]*b[0]-a[0]*b[2];
+    c[2]=a[0]*b[1]-a[1]*b[0];
+}
+static double cnrm2sq(const SEISPP::Complex *a)
+{
+    return(std::norm(a[0])+std::norm(a[1])+std::norm(a[2]));
+}
+double dominant_eigenpair(PMCovariance& cov, SEISPP::Complex v[3])
+{
+    SEISPP::Complex A[3][3];
+    A[0][0]=SEISPP::Complex(cov.c00,0.0);
+    A[1][1]=SEISPP::Complex(cov.c11,0.0);
+    A[2][2]=SEISPP::Complex(cov.c22,0.0);
+    A[0][1]=cov.c01;  A[1][0]=std::conj(cov.c01);
+    A[0][2]=cov.c02;  A[2][0]=std::conj(cov.c02);
+    A[1][2]=cov.c12;  A[2][1]=std::conj(cov.c12);
+    double offdiag=std::norm(cov.c01)+std::norm(cov.c02)+std::norm(cov.c12);
+    double m=(cov.c00+cov.c11+cov.c22)/3.0;
+    double a=cov.c00-m;
+    double b=cov.c11-m;
+    double c=cov.c22-m;
+    /* Frobenius norm squared of A - used as a scale for tests */
+    double anrm2=cov.c00*cov.c00+cov.c11*cov.c11+cov.c22*cov.c22
+        + 2.0*offdiag;
+    int i,j,k;
+    if(anrm2<=0.0)
+    {
+        v[0]=SEISPP::Complex(1.0,0.0);
+        v[1]=SEISPP::Complex(0.0,0.0);
+        v[2]=SEISPP::Complex(0.0,0.0);
+        return(0.0);
+    }
+    double p=(a*a+b*b+c*c+2.0*offdiag)/6.0;
+    double lambda;
+    if(p<=0.0)
+        lambda=m;
+    else
+    {
+        /* q=det(K)/2 */
+        double q=a*b*c + 2.0*std::real(cov.c01*cov.c12*std::conj(cov.c02))
+            - a*std::norm(cov.c12) - b*std::norm(cov.c02) 
+            - c*std::norm(cov.c01);
+        q/=2.0;
+        double sqrtp=sqrt(p);
+        double r=q/(p*sqrtp);
+        if(r>1.0) r=1.0;
+        if(r<-1.0) r=-1.0;
+        double phi=acos(r)/3.0;
+        lambda=m+2.0*sqrtp*cos(phi);
+    }
+    /* Rows of A-lambda*I */
+    SEISPP::Complex M[3][3];
+    for(i=0;i<3;++i)
+        for(j=0;j<3;++j)
+            M[i][j]=A[i][j];
+    for(i=0;i<3;++i) M[i][i]-=lambda;
+    SEISPP::Complex w[3],wbest[3];
+    double wnrm,wnrmbest(-1.0);
+    const int pairs[3][2]={{0,1},{0,2},{1,2}};
+    for(k=0;k<3;++k)
+    {
+        ccross(M[pairs[k][0]],M[pairs[k][1]],w);
+        wnrm=cnrm2sq(w);
+        if(wnrm>wnrmbest)
+        {
+            wnrmbest=wnrm;
+            for(i=0;i<3;++i) wbest[i]=w[i];
+        }
+    }
+    /* Cross product of rows scales as norm(A)^2 so this test is 
+       relative to anrm2 squared */
+    if(wnrmbest <= (64.0*DBL_EPSILON*DBL_EPSILON*anrm2*anrm2))
+    {
+        /* Repeated dominant eigenvalue.  Find largest row and 
+           take the cross product with the unit vector along its 
+           smallest component.  */
+        double rnrm,rnrmbest(-1.0);
+        int ibest(0);
+        for(i=0;i<3;++i)
+        {
+            rnrm=cnrm2sq(M[i]);
+            if(rnrm>rnrmbest)
+            {
+                rnrmbest=rnrm;
+                ibest=i;
+            }
+        }
+        if(rnrmbest<=(64.0*DBL_EPSILON*DBL_EPSILON*anrm2))
+        {
+            /* A is a multiple of I */
+            wbest[0]=SEISPP::Complex(1.0,0.0);
+            wbest[1]=SEISPP::Complex(0.0,0.0);
+            wbest[2]=SEISPP::Complex(0.0,0.0);
+        }
+        else
+        {
+            int kmin(0);
+            for(k=1;k<3;++k)
+                if(std::abs(M[ibest][k])<std::abs(M[ibest][kmin])) kmin=k;
+            SEISPP::Complex e[3];
+            for(k=0;k<3;++k) e[k]=SEISPP::Complex(0.0,0.0);
+            e[kmin]=SEISPP::Complex(1.0,0.0);
+            ccross(M[ibest],e,wbest);
+        }
+    }
+    /* One power iteration step followed by normalization */
+    for(i=0;i<3;++i)
+    {
+        w[i]=SEISPP::Complex(0.0,0.0);
+        for(j=0;j<3;++j) w[i]+=A[i][j]*wbest[j];
+    }
+    wnrm=sqrt(cnrm2sq(w));
+    if(wnrm<=0.0)
+    {
+        /* Happens only if wbest is in the null space of A, which 
+           means lambda is zero */
+        wnrm=sqrt(cnrm2sq(wbest));
+        for(i=0;i<3;++i) v[i]=wbest[i]/wnrm;
+        return(0.0);
+    }
+    for(i=0;i<3;++i) v[i]=w[i]/wnrm;
+    /* Rayleigh quotient v^H A v */
+    SEISPP::Complex Av;
+    double rq(0.0);
+    for(i=0;i<3;++i)
+    {
+        Av=SEISPP::Complex(0.0,0.0);
+        for(j=0;j<3;++j) Av+=A[i][j]*v[j];
+        rq+=std::real(std::conj(v[i])*Av);
+    }
+    return(rq);
+}
@@ -24,3 +24,10 @@ int random_array_index(int range) {
     int dfort=dist(gen);
     return(dfort-1);
 }
+/* Same as random_array_index but fills out with n values.  The 
+   distribution object is built once for all n draws. */
+void random_array_indices(int range, int n, int *out)
+{
+    boost::random::uniform_int_distribution<> dist(0, range-1);
+    for(int i=0;i<n;++i) out[i]=dist(gen);
+}
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <vector>
+#include <math.h>
 /* these are needed to generate normally distributed random numbers */
 #include <ctime>
 #include <boost/random/mersenne_twister.hpp>
@@ -8,9 +9,23 @@
 #include <boost/random/normal_distribution.hpp>
 #include <boost/math/distributions/normal.hpp>
 #include "../Vector3DBootstrapError.h"
+#include "../PMTimeSeries.h"
 #include "dmatrix.h"
 using namespace std;
 using namespace boost;
+/* Count of heap allocations used by the allocation benchmark */
+static long nallocs(0);
+void *operator new(size_t n)
+{
+  ++nallocs;
+  void *p=malloc(n);
+  if(p==NULL) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) throw()
+{
+  free(p);
+}
 double SampleNormal(const double mean, const double sigma)
 {
     /* Generate a random number from the current time */
@@ -64,4 +79,132 @@ int main(int argc, char **argv)
     <<", "<<deltad[2]<<")"<<endl;
   double dtheta=dstat.angle_error();
   cout << "Angle error (radians)="<<dtheta<<endl;
+  /* Benchmark of steady state cost with and without caller supplied
+     work space.   The first call with work sizes the work space so 
+     subsequent calls of the same size should allocate nothing. */
+  cout << "Vector3DBootstrapError allocation benchmark"<<endl;
+  const int nbench(2000);
+  const int nbstrials(800);
+  MultiStatisticBootstrap work;
+  Vector3DBootstrapError warmup(d,ci,nbstrials,work);
+  long nstart=nallocs;
+  clock_t cstart=clock();
+  for(i=0;i<nbench;++i)
+  {
+    Vector3DBootstrapError v(d,ci,nbstrials);
+  }
+  double tnowork=((double)(clock()-cstart))/((double)CLOCKS_PER_SEC);
+  long nnowork=nallocs-nstart;
+  nstart=nallocs;
+  cstart=clock();
+  for(i=0;i<nbench;++i)
+  {
+    Vector3DBootstrapError v(d,ci,nbstrials,work);
+  }
+  double twork=((double)(clock()-cstart))/((double)CLOCKS_PER_SEC);
+  long nwork=nallocs-nstart;
+  cout << nbench<<" constructions with "<<nbstrials<<" trials"<<endl
+    << "Without work space:  "<<tnowork<<" s, "
+    << nnowork<<" heap allocations"<<endl
+    << "With work space:  "<<twork<<" s, "
+    << nwork<<" heap allocations"<<endl;
+  /* Same benchmark for ComputePMStats which is the per sample cost of
+     the PMTimeSeries constructors and PMTimeFrequencyGrid.  The work 
+     space version is the one the library uses. */
+  cout << "ComputePMStats allocation benchmark"<<endl;
+  const int npmw(8);
+  double pmup[3]={0.0,0.0,1.0};
+  vector<ParticleMotionEllipse> pmbench;
+  for(i=0;i<npmw;++i)
+    pmbench.push_back(ParticleMotionEllipse(
+          SEISPP::Complex(1.0+SampleNormal(0.0,0.1),SampleNormal(0.0,0.1)),
+          SEISPP::Complex(SampleNormal(0.0,0.1),0.5+SampleNormal(0.0,0.1)),
+          SEISPP::Complex(0.7+SampleNormal(0.0,0.1),SampleNormal(0.0,0.1)),
+          pmup));
+  PMTimeSeriesControl pmdefaults;
+  PMStatsWorkspace pmwork;
+  ParticleMotionEllipse pmavg;
+  ParticleMotionError pmerr;
+  CounterRNG warmrng(1,0,0,0);
+  ComputePMStats(&(pmbench[0]),npmw,1,pmavg,pmerr,ci,nbstrials,warmrng,
+          pmdefaults,pmwork);
+  nstart=nallocs;
+  cstart=clock();
+  for(i=0;i<nbench;++i)
+  {
+    CounterRNG rng(1,i,0,0);
+    ComputePMStats(pmbench,pmavg,pmerr,ci,nbstrials,rng,pmdefaults);
+  }
+  tnowork=((double)(clock()-cstart))/((double)CLOCKS_PER_SEC);
+  nnowork=nallocs-nstart;
+  nstart=nallocs;
+  cstart=clock();
+  for(i=0;i<nbench;++i)
+  {
+    CounterRNG rng(1,i,0,0);
+    ComputePMStats(&(pmbench[0]),npmw,1,pmavg,pmerr,ci,nbstrials,rng,
+            pmdefaults,pmwork);
+  }
+  twork=((double)(clock()-cstart))/((double)CLOCKS_PER_SEC);
+  nwork=nallocs-nstart;
+  cout << nbench<<" calls with "<<npmw<<" estimates and "<<nbstrials
+    <<" trials"<<endl
+    << "Without work space:  "<<tnowork<<" s, "
+    << nnowork<<" heap allocations"<<endl
+    << "With work space:  "<<twork<<" s, "
+    << nwork<<" heap allocations"<<endl;
+  /* Validation of the jackknife error estimator against the
+     bootstrap.  Synthetic ellipse estimates for nw wavelets are
+     scattered about a fixed ellipse with increasing noise.  Average
+     intervals from both methods and their ratio are printed for
+     each noise level. */
+  cout << "Comparing jackknife and bootstrap errors for ComputePMStats"
+    <<endl;
+  const int nw(8);
+  const int nrealizations(200);
+  const int bsmultiplier(100);
+  double up[3]={0.0,0.0,1.0};
+  PMTimeSeriesControl bscontrol,jkcontrol;
+  jkcontrol.error_estimator=PMJackknifeErrors;
+  cout << "noise  dmajornrm(bs jk ratio)  delta_rect(bs jk ratio)  "
+    << "dtheta_major(bs jk ratio)  dtheta_minor(bs jk ratio)"<<endl;
+  double noise;
+  for(noise=0.02;noise<0.5;noise*=2.0)
+  {
+    double bs[4]={0.0,0.0,0.0,0.0},jk[4]={0.0,0.0,0.0,0.0};
+    for(int r=0;r<nrealizations;++r)
+    {
+      vector<ParticleMotionEllipse> pmw;
+      for(int iw=0;iw<nw;++iw)
+      {
+        SEISPP::Complex z[3];
+        /* Minor axis is tilted from horizontal so the up convention
+           fixes its sign */
+        z[0]=SEISPP::Complex(1.0+SampleNormal(0.0,noise),
+                -0.21+SampleNormal(0.0,noise));
+        z[1]=SEISPP::Complex(SampleNormal(0.0,noise),
+                0.5+SampleNormal(0.0,noise));
+        z[2]=SEISPP::Complex(0.7+SampleNormal(0.0,noise),
+                0.3+SampleNormal(0.0,noise));
+        pmw.push_back(ParticleMotionEllipse(z[0],z[1],z[2],up));
+      }
+      ParticleMotionEllipse avg;
+      ParticleMotionError err;
+      CounterRNG rng(1,r,0,0);
+      ComputePMStats(pmw,avg,err,ci,bsmultiplier*nw,rng,bscontrol);
+      bs[0]+=err.dmajornrm; bs[1]+=err.delta_rect;
+      bs[2]+=err.dtheta_major; bs[3]+=err.dtheta_minor;
+      ComputePMStats(pmw,avg,err,ci,bsmultiplier*nw,rng,jkcontrol);
+      jk[0]+=err.dmajornrm; jk[1]+=err.delta_rect;
+      jk[2]+=err.dtheta_major; jk[3]+=err.dtheta_minor;
+    }
+    cout << noise;
+    for(i=0;i<4;++i)
+    {
+      bs[i]/=((double)nrealizations);
+      jk[i]/=((double)nrealizations);
+      cout << "  "<<bs[i]<<" "<<jk[i]<<" "<<jk[i]/bs[i];
+    }
+    cout << endl;
+  }
 }
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include "../ParticleMotionEllipse.h"
+/* Test program for the closed form dominant eigenpair solver that
+   replaced cgesvd in the windowed ParticleMotionEllipse constructor.
+   Each test window is solved both ways and the resulting ellipses are
+   compared.   cgesvd works in single precision so differences of 
+   order 1e-6 relative are expected.  
+
+   Usage:  testeigen [datafile nwin]
+
+   With no arguments only synthetic data are used.  If a data file 
+   is given it is read as lines of 6 numbers (xr xi yr yi zr zi) - e.g.
+   one wavelet of a multiwavelet transform dumped to text - and a 
+   sliding window of nwin samples is run through the data. */
+using namespace std;
+extern "C" {
+void cgesvd ( char jobu, char jobvt, int m, int n, 
+        FORTRAN_complex *ca, int lda, float *s, FORTRAN_complex *cu, int ldu, 
+        FORTRAN_complex *cvt, int ldvt, int *info );
+}
+double up[3]={0.0,0.0,1.0};
+/* This is the algorithm the windowed constructor used before */
+ParticleMotionEllipse svd_ellipse(vector<SEISPP::Complex>& x,
+        vector<SEISPP::Complex>& y, vector<SEISPP::Complex>& z)
+{
+    int ntw=x.size();
+    vector<FORTRAN_complex> A(3*ntw);
+    FORTRAN_complex *U,*Vt;
+    float svalues[3];
+    int i,ia,info;
+    for(i=0,ia=0;i<ntw;++i,ia+=3)
+    {
+        A[ia].r=x[i].real();  A[ia].i=x[i].imag();
+        A[ia+1].r=y[i].real();  A[ia+1].i=y[i].imag();
+        A[ia+2].r=z[i].real();  A[ia+2].i=z[i].imag();
+    }
+    cgesvd('o','n',3,ntw,&(A[0]),3,svalues,U,3,Vt,3,&info);
+    if(info!=0)
+    {
+        cerr << "cgesvd failed - info="<<info<<endl;
+        exit(-1);
+    }
+    SEISPP::Complex xz(A[0].r,A[0].i),yz(A[1].r,A[1].i),zz(A[2].r,A[2].i);
+    xz*=svalues[0];
+    yz*=svalues[0];
+    zz*=svalues[0];
+    return(ParticleMotionEllipse(xz,yz,zz,up));
+}
+ParticleMotionEllipse cov_ellipse(vector<SEISPP::Complex>& x,
+        vector<SEISPP::Complex>& y, vector<SEISPP::Complex>& z)
+{
+    PMCovariance cov;
+    for(int i=0;i<x.size();++i) cov.add(x[i],y[i],z[i]);
+    return(ParticleMotionEllipse(cov,up));
+}
+double urand()
+{
+    return(2.0*((double)random())/((double)RAND_MAX) - 1.0);
+}
+/* Accumulates maximum differences between the two methods */
+class Compare
+{
+public:
+    double nrm,major,minor;
+    int n;
+    Compare(){nrm=0.0;major=0.0;minor=0.0;n=0;};
+    void add(ParticleMotionEllipse& a, ParticleMotionEllipse& b)
+    {
+        double d;
+        d=fabs(a.majornrm-b.majornrm)/a.majornrm;
+        if(d>nrm) nrm=d;
+        for(int k=0;k<3;++k)
+        {
+            d=fabs(a.major[k]-b.major[k]);
+            if(d>major) major=d;
+            /* Minor axis is poorly defined for nearly linear motion */
+            if(a.rectilinearity()<0.99)
+            {
+                d=fabs(a.minor[k]-b.minor[k]);
+                if(d>minor) minor=d;
+            }
+        }
+        ++n;
+    };
+    void report(const char *name)
+    {
+        cout << name << ":  "<<n<<" windows, max relative major norm "
+            << "difference="<<nrm<<" max major vector difference="<<major
+            << " max minor vector difference="<<minor<<endl;
+    };
+};
+int main(int argc, char **argv)
+{
+    const int ntrials(1000);
+    const int nwin(21);
+    vector<SEISPP::Complex> x(nwin),y(nwin),z(nwin);
+    int i,j;
+    ParticleMotionEllipse e1,e2;
+    cout << "Comparing closed form eigenpair solution to cgesvd"<<endl;
+    Compare crandom;
+    for(j=0;j<ntrials;++j)
+    {
+        for(i=0;i<nwin;++i)
+        {
+            x[i]=SEISPP::Complex(urand(),urand());
+            y[i]=SEISPP::Complex(urand(),urand());
+            z[i]=SEISPP::Complex(urand(),urand());
+        }
+        e1=svd_ellipse(x,y,z);
+        e2=cov_ellipse(x,y,z);
+        crandom.add(e1,e2);
+    }
+    crandom.report("Random noise windows");
+    /* Harmonic particle motion with a random ellipse plus 5% noise.  
+       This is the normal case for seismic data */
+    Compare csignal;
+    for(j=0;j<ntrials;++j)
+    {
+        SEISPP::Complex a(urand(),urand()),b(urand(),urand()),
+            c(urand(),urand());
+        for(i=0;i<nwin;++i)
+        {
+            SEISPP::Complex phase=std::polar(1.0,0.3*((double)i));
+            x[i]=a*phase+0.05*SEISPP::Complex(urand(),urand());
+            y[i]=b*phase+0.05*SEISPP::Complex(urand(),urand());
+            z[i]=c*phase+0.05*SEISPP::Complex(urand(),urand());
+        }
+        e1=svd_ellipse(x,y,z);
+        e2=cov_ellipse(x,y,z);
+        csignal.add(e1,e2);
+    }
+    csignal.report("Harmonic signal plus noise");
+    /* Nearly rectilinear motion with huge amplitude range */
+    Compare clinear;
+    for(j=0;j<ntrials;++j)
+    {
+        double scale=pow(10.0,6.0*urand());
+        double u[3]={urand(),urand(),urand()};
+        for(i=0;i<nwin;++i)
+        {
+            SEISPP::Complex s(scale*urand(),scale*urand());
+            x[i]=s*u[0]+1.0e-4*scale*SEISPP::Complex(urand(),urand());
+            y[i]=s*u[1]+1.0e-4*scale*SEISPP::Complex(urand(),urand());
+            z[i]=s*u[2]+1.0e-4*scale*SEISPP::Complex(urand(),urand());
+        }
+        e1=svd_ellipse(x,y,z);
+        e2=cov_ellipse(x,y,z);
+        clinear.add(e1,e2);
+    }
+    clinear.report("Nearly rectilinear motion");
+    /* Degenerate case - both solutions are arbitrary, but the closed
+       form solution should not produce NaNs */
+    for(i=0;i<nwin;++i)
+    {
+        x[i]=SEISPP::Complex(0.0,0.0);
+        y[i]=x[i];
+        z[i]=x[i];
+    }
+    x[0]=SEISPP::Complex(1.0,0.0);
+    y[1]=SEISPP::Complex(1.0,0.0);
+    z[2]=SEISPP::Complex(1.0,0.0);
+    e2=cov_ellipse(x,y,z);
+    cout << "Identity covariance matrix (any vector is valid):  "
+        << "majornrm="<<e2.majornrm<<" major=("<<e2.major[0]<<", "
+        << e2.major[1]<<", "<<e2.major[2]<<")"<<endl;
+    if(argc>2)
+    {
+        ifstream din(argv[1],ios::in);
+        if(!din)
+        {
+            cerr << "Cannot open data file "<<argv[1]<<endl;
+            exit(-1);
+        }
+        int nw=atoi(argv[2]);
+        vector<SEISPP::Complex> xd,yd,zd;
+        double xr,xi,yr,yi,zr,zi;
+        while(din>>xr>>xi>>yr>>yi>>zr>>zi)
+        {
+            xd.push_back(SEISPP::Complex(xr,xi));
+            yd.push_back(SEISPP::Complex(yr,yi));
+            zd.push_back(SEISPP::Complex(zr,zi));
+        }
+        x.resize(nw);
+        y.resize(nw);
+        z.resize(nw);
+        Compare cdata;
+        for(j=0;j+nw<=xd.size();++j)
+        {
+            for(i=0;i<nw;++i)
+            {
+                x[i]=xd[j+i];
+                y[i]=yd[j+i];
+                z[i]=zd[j+i];
+            }
+            e1=svd_ellipse(x,y,z);
+            e2=cov_ellipse(x,y,z);
+            cdata.add(e1,e2);
+        }
+        cdata.report(argv[1]);
+    }
+}
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <sstream>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include "seispp.h"
@@ -35,6 +36,42 @@ int main(int argc, char **argv)
         ifspe.close();
         cout << "Read completed.  Contents read back follow:"<<endl;
         cout << pmread;
+        cout << "Comparing batched ellipse procedure to scalar constructor"<<endl;
+        const int nbatch(100);
+        double bwork[6][nbatch];
+        int ib,kb;
+        for(ib=0;ib<nbatch;++ib)
+            for(kb=0;kb<6;++kb)
+                bwork[kb][ib]=((double)random())/((double)RAND_MAX) - 0.5;
+        vector<ParticleMotionEllipse> pmbatch(nbatch);
+        ParticleMotionEllipseBatch(nbatch,bwork[0],bwork[1],bwork[2],bwork[3],
+                bwork[4],bwork[5],up,&(pmbatch[0]));
+        double maxdiff(0.0);
+        for(ib=0;ib<nbatch;++ib)
+        {
+            ParticleMotionEllipse pms(Complex(bwork[0][ib],bwork[1][ib]),
+                    Complex(bwork[2][ib],bwork[3][ib]),
+                    Complex(bwork[4][ib],bwork[5][ib]),up);
+            for(kb=0;kb<3;++kb)
+            {
+                double dmaj=fabs(pms.major[kb]-pmbatch[ib].major[kb]);
+                if(dmaj>maxdiff) maxdiff=dmaj;
+            }
+            double dnrm=fabs(pms.majornrm-pmbatch[ib].majornrm)/pms.majornrm;
+            if(dnrm>maxdiff) maxdiff=dnrm;
+        }
+        cout << "Maximum difference in major axis components and norm="
+            << maxdiff<<endl;
+        /* Both compute the same closed form so only roundoff differs */
+        const double batch_tolerance(1.0e-10);
+        if(maxdiff>batch_tolerance)
+        {
+            cerr << "Batched ellipse procedure does not match scalar "
+                << "constructor:  maximum difference="<<maxdiff
+                << " exceeds tolerance="<<batch_tolerance<<endl;
+            exit(-1);
+        }
+        cout << "Batched ellipse procedure matches scalar constructor"<<endl;
         ThreeComponentSeismogram d(2000);
         d.ns=2000;
         d.t0=0.0;
@@ -99,7 +136,45 @@ int main(int argc, char **argv)
             for(k=0;k<3;++k) cout << pmo.major[k]-pmi.major[k]<<" ";
             cout <<endl;
         }
-        
+        cout << "Testing that saving a series with deferred errors "
+            << "does not change its ellipses"<<endl;
+        PMTimeSeriesControl eager;
+        eager.bootstrap_seed=11;
+        PMTimeSeriesControl lazy(eager);
+        lazy.lazy_errors=true;
+        PMTimeSeries pmeager(dtrans,0,0.95,100,eager);
+        PMTimeSeries pmlazy(dtrans,0,0.95,100,lazy);
+        vector<ParticleMotionEllipse> before;
+        for(i=0;i<pmlazy.ns;++i) before.push_back(pmlazy.ellipse(i));
+        std::ostringstream lazyout;
+        boost::archive::text_oarchive olazy(lazyout);
+        olazy << pmlazy;
+        double ediff(0.0),errdiff(0.0);
+        for(i=0;i<pmlazy.ns;++i)
+        {
+            ParticleMotionEllipse pml(pmlazy.ellipse(i));
+            ParticleMotionEllipse pme(pmeager.ellipse(i));
+            ParticleMotionError errl(pmlazy.errors(i));
+            ParticleMotionError erre(pmeager.errors(i));
+            ediff=max(ediff,fabs(pml.majornrm-before[i].majornrm));
+            ediff=max(ediff,fabs(pml.majornrm-pme.majornrm));
+            for(k=0;k<3;++k)
+            {
+                ediff=max(ediff,fabs(pml.major[k]-before[i].major[k]));
+                ediff=max(ediff,fabs(pml.major[k]-pme.major[k]));
+            }
+            errdiff=max(errdiff,fabs(errl.dtheta_major-erre.dtheta_major));
+            errdiff=max(errdiff,fabs(errl.dmajornrm-erre.dmajornrm));
+        }
+        if(pmlazy.errors_deferred() || (ediff>0.0) || (errdiff>0.0))
+        {
+            cerr << "Deferred error test failed:  maximum ellipse "
+                << "difference="<<ediff<<" maximum error difference="
+                << errdiff<<endl;
+            exit(-1);
+        }
+        cout << "Saved deferred series matches series computed with "
+            << "errors"<<endl;
     }catch(SeisppError& serr)
     {
         serr.log_error();